@@ -3,6 +3,12 @@
 #include "FrameAllocator.h"
 #include "UefiTypes.h"
 
+/// The virtual address of the physical memory mapping, which is the beginning of the kernel half of the address space.
+#define PHYSICAL_MEMORY_MAPPING_OFFSET 0xffff800000000000
+/// The mapping spans as many P4 entries as the amount of RAM needs, short of the top two, which belong to the kernel's executable
+/// and its own mappings, and the one right below them, kept for the memory map placed right after the mapping.
+#define PHYSICAL_MEMORY_MAPPING_MAX_SIZE 0x7e8000000000 // 253 P4 entries, 126.5 TiB
+
 /// Necessary information for the kernel to properly boot.
 /// It's passed in the first argument of the kernel's main function.
 typedef struct KernelBootInfo {
@@ -64,6 +64,15 @@ UINT64 PageTableEntry(EFI_PHYSICAL_ADDRESS address, UINT16 flags);
 EFI_STATUS MapMemoryPage4KiB(EFI_VIRTUAL_ADDRESS pageStart, EFI_PHYSICAL_ADDRESS frameStart, EFI_PHYSICAL_ADDRESS p4PhysicalAddress,
 	FrameAllocatorData* frameAllocator, UINT64 flags);
 
+/// Checks whether the processor supports 1GiB pages (the `pdpe1gb` CPUID flag).
+BOOLEAN Supports1GiBPages();
+
+/// Maps the given memory page to the given 1GiB physical memory frame
+/// in the given Level 4 Page Table's hierarchy,
+/// creating all the necessary intermediate tables if neccessary.
+EFI_STATUS MapMemoryPage1GiB(EFI_VIRTUAL_ADDRESS pageStart, EFI_PHYSICAL_ADDRESS frameStart, EFI_PHYSICAL_ADDRESS p4PhysicalAddress,
+	FrameAllocatorData* frameAllocator, UINT64 flags);
+
 /// Maps the given memory page to the given 2MiB physical memory frame
 /// in the given Level 4 Page Table's hierarchy,
 /// creating all the necessary intermediate tables if neccessary.
@@ -17,3 +17,7 @@ typedef struct MemoryMapEntry {
 /// by the sequential frame allocator used. Outputs the number of entries in the kernel memory map.
 EFI_STATUS CreateMemoryMap(FrameAllocatorData* frameAllocator, EFI_PHYSICAL_ADDRESS kernelP4Table, UINTN* memoryMapEntries,
 	EFI_MEMORY_DESCRIPTOR* uefiMemoryMap, UINTN memoryMapSize, UINTN descriptorSize, EFI_VIRTUAL_ADDRESS memoryMapVirtualAddress);
+
+/// Returns the end of the highest addressed memory region in the UEFI memory map, which is not memory mapped I/O.
+/// This is the amount of physical memory that should be accessible through the physical memory mapping.
+UINTN PhysicalMemorySize(EFI_MEMORY_DESCRIPTOR* uefiMemoryMap, UINTN memoryMapSize, UINTN descriptorSize);
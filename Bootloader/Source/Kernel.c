@@ -27,8 +27,8 @@ EFI_STATUS LoadKernelArgs(const INT8* configFile, UINTN configFileSize, FrameAll
 	MemoryCopy((INT8*)args, (VOID*)frameAddress, argsLength);
 	*((INT8*)frameAddress + argsLength) = '\0';
 
-	status = MapMemoryPage4KiB(
-		*nextUsableVirtualPage, frameAddress, p4TableAddress, frameAllocator, ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE);
+	status = MapMemoryPage4KiB(*nextUsableVirtualPage, frameAddress, p4TableAddress, frameAllocator,
+		ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE | ENTRY_GLOBAL);
 	if (EFI_ERROR(status)) {
 		SN_LOG_ERROR(L"An unexpected error occured while trying to map a memory frame in the kernel's P4 table");
 		return status;
@@ -73,7 +73,8 @@ EFI_STATUS LoadKernel(UINT8* loadedFile, FrameAllocatorData* frameAllocator, EFI
 			MemoryFill((VOID*)frameAddress, 0, 4096);
 			MemoryCopy(loadedFile + header->p_offset + j * 4096, (VOID*)frameAddress, header->p_filesz);
 
-			UINT64 flags = ENTRY_PRESENT;
+			// The kernel is mapped into every address space, so its TLB entries don't have to be flushed on address space switches
+			UINT64 flags = ENTRY_PRESENT | ENTRY_GLOBAL;
 			if (header->p_flags & PF_W)
 				flags |= ENTRY_WRITEABLE;
 
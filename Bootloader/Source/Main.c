@@ -128,8 +128,8 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable
 			goto halt;
 		}
 
-		status = MapMemoryPage4KiB(
-			nextUsableVirtualPage, frameAddress, kernelP4Table, &frameAllocator, ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE);
+		status = MapMemoryPage4KiB(nextUsableVirtualPage, frameAddress, kernelP4Table, &frameAllocator,
+			ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE | ENTRY_GLOBAL);
 		if (EFI_ERROR(status)) {
 			goto halt;
 		}
@@ -148,7 +148,7 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable
 	}
 
 	status = MapMemoryPage4KiB(bootInfoVirtualAddress, bootInfoPhysicalAddress, kernelP4Table, &frameAllocator,
-		ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE);
+		ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE | ENTRY_GLOBAL);
 	if (EFI_ERROR(status)) {
 		goto halt;
 	}
@@ -178,7 +178,7 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable
 	bootInfo->framebufferAddress = framebufferVirtualAddress + framebufferFrameOffset;
 	for (UINTN i = 0; i < framebufferPages; i++) {
 		status = MapMemoryPage4KiB(framebufferVirtualAddress, framebufferPhysicalAddress, kernelP4Table, &frameAllocator,
-			ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE);
+			ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE | ENTRY_GLOBAL);
 		if (EFI_ERROR(status)) {
 			goto halt;
 		}
@@ -187,19 +187,42 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE imageHandle, EFI_SYSTEM_TABLE* systemTable
 		framebufferVirtualAddress += 4096;
 	}
 
-	bootInfo->physicalMemoryMappingSize = 1073741824; // 1 GiB
-	// Round the next available virtual address to the nearest 2 MiB
-	bootInfo->physicalMemoryOffset = (framebufferVirtualAddress + 0x1FFFFF) & ~0x1FFFFF;
-	// Mapping the whole (512 huge pages for now) physical memory at an offset using 2 MiB huge pages
+	// The physical memory mapping begins at the start of the kernel half, just like the kernel itself it's shared with every process
+	bootInfo->physicalMemoryOffset = PHYSICAL_MEMORY_MAPPING_OFFSET;
 	EFI_VIRTUAL_ADDRESS mappingOffset = bootInfo->physicalMemoryOffset;
-	for (UINT64 i = 0; i < 512; i++) {
-		status = MapMemoryPage2MiB(
-			mappingOffset, 0x200000 * i, kernelP4Table, &frameAllocator, ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_HUGE_PAGE);
-		if (EFI_ERROR(status)) {
-			goto halt;
+
+	UINTN physicalMemorySize = PhysicalMemorySize(memoryMap, memoryMapSize, descriptorSize);
+	if (physicalMemorySize > PHYSICAL_MEMORY_MAPPING_MAX_SIZE) {
+		SN_LOG_WARN(L"Only the first 126.5 TiB of physical memory will be accessible to the kernel");
+		physicalMemorySize = PHYSICAL_MEMORY_MAPPING_MAX_SIZE;
+	}
+
+	// Mapping the whole physical memory at an offset, using 1 GiB huge pages when possible and 2 MiB huge pages otherwise.
+	// Like every other kernel mapping it's global, the kernel enables global pages before any address space switch
+	if (Supports1GiBPages()) {
+		bootInfo->physicalMemoryMappingSize = (physicalMemorySize + 0x3fffffff) & ~0x3fffffffULL;
+
+		for (UINTN frame = 0; frame < bootInfo->physicalMemoryMappingSize; frame += 0x40000000) {
+			status = MapMemoryPage1GiB(
+				mappingOffset, frame, kernelP4Table, &frameAllocator, ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_HUGE_PAGE | ENTRY_GLOBAL);
+			if (EFI_ERROR(status)) {
+				goto halt;
+			}
+
+			mappingOffset += 0x40000000;
 		}
+	} else {
+		bootInfo->physicalMemoryMappingSize = (physicalMemorySize + 0x1fffff) & ~0x1fffffULL;
 
-		mappingOffset += 0x200000;
+		for (UINTN frame = 0; frame < bootInfo->physicalMemoryMappingSize; frame += 0x200000) {
+			status = MapMemoryPage2MiB(
+				mappingOffset, frame, kernelP4Table, &frameAllocator, ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_HUGE_PAGE | ENTRY_GLOBAL);
+			if (EFI_ERROR(status)) {
+				goto halt;
+			}
+
+			mappingOffset += 0x200000;
+		}
 	}
 
 	// After this function call, no other frame allocations should be performed
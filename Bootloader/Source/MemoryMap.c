@@ -30,7 +30,7 @@ EFI_STATUS CreateMemoryMap(FrameAllocatorData* frameAllocator, EFI_PHYSICAL_ADDR
 
 	for (UINTN i = 0; i < memoryMapPages; i++) {
 		status = MapMemoryPage4KiB(memoryMapVirtualAddress, mapPhysicalAddress + i * 4096, kernelP4Table, frameAllocator,
-			ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE);
+			ENTRY_PRESENT | ENTRY_WRITEABLE | ENTRY_NO_EXECUTE | ENTRY_GLOBAL);
 		if (EFI_ERROR(status)) {
 			return status;
 		}
@@ -66,3 +66,24 @@ EFI_STATUS CreateMemoryMap(FrameAllocatorData* frameAllocator, EFI_PHYSICAL_ADDR
 
 	return status;
 }
+
+UINTN PhysicalMemorySize(EFI_MEMORY_DESCRIPTOR* uefiMemoryMap, UINTN memoryMapSize, UINTN descriptorSize)
+{
+	UINTN size = 0;
+
+	for (UINTN i = 0; i < memoryMapSize / descriptorSize; i++) {
+		// sizeof(EFI_MEMORY_DESCRIPTOR) is not the same as its size in memory
+		const EFI_MEMORY_DESCRIPTOR* descriptor = (EFI_MEMORY_DESCRIPTOR*)((UINT8*)uefiMemoryMap + (i * descriptorSize));
+
+		// Devices get mapped by the kernel on their own, with the right caching attributes
+		if (descriptor->Type == EfiMemoryMappedIO || descriptor->Type == EfiMemoryMappedIOPortSpace)
+			continue;
+
+		UINTN descriptorEnd = descriptor->PhysicalStart + descriptor->NumberOfPages * 4096;
+		if (descriptorEnd > size) {
+			size = descriptorEnd;
+		}
+	}
+
+	return size;
+}
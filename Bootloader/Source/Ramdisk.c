@@ -24,7 +24,8 @@ EFI_STATUS LoadRamdisk(UINT8* loadedFile, UINTN fileSize, FrameAllocatorData* fr
 
 		MemoryCopy(loadedFile + (i * 4096), (VOID*)frameAddress, copySize);
 
-		status = MapMemoryPage4KiB(*nextUsableVirtualPage, frameAddress, p4TableAddress, frameAllocator, ENTRY_PRESENT | ENTRY_NO_EXECUTE);
+		status = MapMemoryPage4KiB(
+			*nextUsableVirtualPage, frameAddress, p4TableAddress, frameAllocator, ENTRY_PRESENT | ENTRY_NO_EXECUTE | ENTRY_GLOBAL);
 		if (EFI_ERROR(status)) {
 			SN_LOG_ERROR(L"An unexpected error occured while trying to map a memory frame in the kernel's P4 table");
 			return status;
@@ -78,6 +78,69 @@ typedef struct __attribute__((packed)) MADT {
 
 u8 MADTGetAPICEntry(const MADT* madt, MADTBaseEntry** pointer);
 
+typedef enum SRATEntryType : u8 {
+	SRATEntryProcessorAPICAffinity = 0,
+	SRATEntryMemoryAffinity = 1,
+	SRATEntryProcessorX2APICAffinity = 2,
+} SRATEntryType;
+
+constexpr u32 SRAT_ENTRY_ENABLED = 1;
+
+typedef struct __attribute__((packed)) SRATBaseEntry {
+	u8 Type;
+	u8 Length;
+} SRATBaseEntry;
+
+typedef struct __attribute__((packed)) SRATEntryAPIC {
+	SRATBaseEntry Base;
+	u8 ProximityDomainLow;
+	u8 APICID;
+	u32 Flags;
+	u8 SAPICEID;
+	u8 ProximityDomainHigh[3];
+	u32 ClockDomain;
+} SRATEntryAPIC;
+
+typedef struct __attribute__((packed)) SRATEntryMemory {
+	SRATBaseEntry Base;
+	u32 ProximityDomain;
+	u16 Reserved1;
+	u64 BaseAddress;
+	u64 Length;
+	u32 Reserved2;
+	u32 Flags;
+	u64 Reserved3;
+} SRATEntryMemory;
+
+typedef struct __attribute__((packed)) SRATEntryX2APIC {
+	SRATBaseEntry Base;
+	u16 Reserved1;
+	u32 ProximityDomain;
+	u32 X2APICID;
+	u32 Flags;
+	u32 ClockDomain;
+	u32 Reserved2;
+} SRATEntryX2APIC;
+
+typedef struct __attribute__((packed)) SRAT {
+	SDTHeader Header;
+
+	u32 Reserved1;
+	u64 Reserved2;
+
+	SRATBaseEntry Entries[];
+} SRAT;
+
+u8 SRATGetEntry(const SRAT* srat, SRATBaseEntry** pointer);
+
+typedef struct __attribute__((packed)) SLIT {
+	SDTHeader Header;
+
+	u64 LocalityCount;
+	/// A `LocalityCount` by `LocalityCount` matrix of relative distances between proximity domains.
+	u8 Entries[];
+} SLIT;
+
 Result InitXSDT();
 
 extern XSDT* g_xsdt;
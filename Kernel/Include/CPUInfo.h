@@ -21,6 +21,10 @@ typedef struct CPUInfo {
 	bool SupportsRDRAND;
 	bool SupportsRDSEED;
 
+	bool SupportsPGE;
+	bool SupportsPCID;
+	bool SupportsINVPCID;
+
 	bool SupportsXAPIC; // Or just APIC
 	bool SupportsX2APIC;
 
@@ -28,6 +32,13 @@ typedef struct CPUInfo {
 	u8 VirtAddrBits;
 } CPUInfo;
 
+/// The maximum number of logical processors the kernel keeps per-CPU state for.
+constexpr usz MAX_CPUS = 64;
+
+/// Returns the index of the logical processor executing this code, used for accessing per-CPU state.
+/// Application processors are not brought up yet, so everything runs on the bootstrap processor.
+static inline usz CPUCurrentIndex() { return 0; }
+
 /// A wrapper around the CPUID macros from GCC with some error checks.
 Result CPUID(const CPUInfo* cpuInfo, u32 leaf, u32 subleaf, CPUIDResult* result);
 
@@ -4,6 +4,8 @@
 #include "Result.h"
 #include "Scheduler.h"
 
+constexpr usz MAX_ELF_SEGMENTS = 32;
+
 typedef struct ELFSegmentRegion {
 	/// Inclusive.
 	Page4KiB Begin;
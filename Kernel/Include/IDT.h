@@ -39,4 +39,22 @@ static inline void EnableInterrupts() { __asm__ volatile("sti"); }
 /// Executes the `cli` instruction.
 static inline void DisableInterrupts() { __asm__ volatile("cli"); }
 
+/// Executes the `cli` instruction, returning whether interrupts were enabled before it.
+static inline bool SaveAndDisableInterrupts()
+{
+	u64 rflags = 0;
+	__asm__ volatile("pushfq\n\tpop %0\n\tcli" : "=r"(rflags) : : "memory");
+
+	// RFLAGS.IF
+	return rflags & (1 << 9);
+}
+
+/// Enables interrupts again only if they were enabled before the matching `SaveAndDisableInterrupts`.
+static inline void RestoreInterrupts(bool enabled)
+{
+	if (enabled) {
+		__asm__ volatile("sti" : : : "memory");
+	}
+}
+
 extern IDTEntry g_idt[256];
@@ -28,6 +28,48 @@ static inline void WriteMSR(u32 msr, u64 value)
 	__asm__ volatile("wrmsr" : : "c"(msr), "a"(low), "d"(high));
 }
 
+static inline u64 ReadCR0()
+{
+	u64 value = 0;
+	__asm__ volatile("mov %%cr0, %0" : "=r"(value));
+
+	return value;
+}
+
+static inline void WriteCR0(u64 value) { __asm__ volatile("mov %0, %%cr0" : : "r"(value) : "memory"); }
+
+static inline u64 ReadCR3()
+{
+	u64 value = 0;
+	__asm__ volatile("mov %%cr3, %0" : "=r"(value));
+
+	return value;
+}
+
+static inline void WriteCR3(u64 value) { __asm__ volatile("mov %0, %%cr3" : : "r"(value) : "memory"); }
+
+static inline u64 ReadCR4()
+{
+	u64 value = 0;
+	__asm__ volatile("mov %%cr4, %0" : "=r"(value));
+
+	return value;
+}
+
+static inline void WriteCR4(u64 value) { __asm__ volatile("mov %0, %%cr4" : : "r"(value) : "memory"); }
+
+static inline void INVLPG(u64 address) { __asm__ volatile("invlpg (%0)" : : "r"(address) : "memory"); }
+
+static inline void INVPCID(u64 type, u64 pcid, u64 address)
+{
+	struct {
+		u64 PCID;
+		u64 Address;
+	} descriptor = { pcid, address };
+
+	__asm__ volatile("invpcid %0, %1" : : "m"(descriptor), "r"(type) : "memory");
+}
+
 static inline void OutU8(u16 port, u8 value) { __asm__ volatile("outb %b0, %w1" : : "a"(value), "Nd"(port) : "memory"); }
 
 static inline u8 InU8(u16 port)
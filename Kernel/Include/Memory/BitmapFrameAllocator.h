@@ -3,26 +3,54 @@
 #include "Core.h"
 #include "Memory.h"
 #include "Memory/Frame.h"
+#include "Memory/FrameZone.h"
 #include "Result.h"
 
+/// The number of `FrameBitmap` words covered by a single `GroupSummary` bit.
+constexpr usz BITMAP_GROUP_WORDS = 4096;
+/// The number of frames (256 MiB) made available by `BitmapFrameAllocatorInit`, enough to get through the boot process.
+constexpr usz BITMAP_BOOT_FRAMES = 65536;
+
 /// A physical frame allocator based on a memory map bitmap.
+/// The bitmap is accompanied by two summary levels, which let single frame allocations skip fully used regions with bit scans.
 typedef struct BitmapFrameAllocator {
 	MemoryMapEntry* MemoryMap;
 	usz MemoryMapEntries;
 	u64* FrameBitmap;
+	/// A bit per `FrameBitmap` word, set when that word contains at least one unallocated frame.
+	u64* WordSummary;
+	/// A bit per `WordSummary` word (so per 4096 bitmap words), set when that word is not empty.
+	u64* GroupSummary;
+	usz BitmapWords;
+	usz GroupSummaryWords;
 	Frame4KiB LastFrame;
 	Frame4KiB LastAllocated;
+	/// The memory map entry and the frame in it where freeing the deferred part of the memory map continues.
+	usz DeferredEntry;
+	Frame4KiB DeferredFrame;
+	/// The number of frames still waiting for `BitmapFreeDeferredFrames`.
+	usz DeferredFrames;
+	/// The number of frames of every zone present in the memory map.
+	usz TotalFrames[FRAME_ZONE_COUNT];
+	/// The number of unallocated frames of every zone.
+	usz FreeFrames[FRAME_ZONE_COUNT];
 } BitmapFrameAllocator;
 
+/// Initializes the bitmap allocator, using the first memory map entry for its metadata.
+/// Only the first `BITMAP_BOOT_FRAMES` frames of the memory map get freed right away, the rest has to be freed with `BitmapFreeDeferredFrames`.
 Result BitmapFrameAllocatorInit(BitmapFrameAllocator* frameAllocator, MemoryMapEntry* memoryMap, usz memoryMapEntries);
+/// Frees up to the given number of the memory map frames left out by `BitmapFrameAllocatorInit`.
+/// Returns the number of frames freed, zero once the whole memory map is available.
+usz BitmapFreeDeferredFrames(BitmapFrameAllocator* frameAllocator, usz maxFrames);
 
-/// Allocates a single 4 KiB memory frame.
-Frame4KiB AllocateFrame(BitmapFrameAllocator* frameAllocator);
-/// Allocates a contiguous range of 4 KiB memory frames.
-Result AllocateContiguousFrames(BitmapFrameAllocator* frameAllocator, usz count, Frame4KiB* frame);
+/// Allocates a single 4 KiB memory frame from the given zone of the given NUMA node.
+Result BitmapAllocateFrame(BitmapFrameAllocator* frameAllocator, u8 node, FrameZone zone, Frame4KiB* frame);
+/// Allocates a contiguous range of 4 KiB memory frames from the given zone of the given NUMA node.
+Result BitmapAllocateContiguousFrames(BitmapFrameAllocator* frameAllocator, u8 node, FrameZone zone, usz count, Frame4KiB* frame);
 /// Deallocates a single 4 KiB memory frame.
-void DeallocateFrame(BitmapFrameAllocator* frameAllocator, Frame4KiB frame);
+void BitmapDeallocateFrame(BitmapFrameAllocator* frameAllocator, Frame4KiB frame);
 /// Deallocates a contiguous range of 4 KiB memory frames.
-Result DeallocateContiguousFrames(BitmapFrameAllocator* frameAllocator, Frame4KiB frame, usz count);
-
-extern BitmapFrameAllocator g_frameAllocator;
+Result BitmapDeallocateContiguousFrames(BitmapFrameAllocator* frameAllocator, Frame4KiB frame, usz count);
+/// Counts every run of contiguous unallocated frames in a histogram, bucket `i` counting runs of 2^i up to 2^(i+1) - 1 frames,
+/// the last bucket also counting all of the longer ones.
+void BitmapFreeRunHistogram(const BitmapFrameAllocator* frameAllocator, usz* runs, usz buckets, usz* largestRun);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Core.h"
+#include "Memory.h"
+#include "Memory/Frame.h"
+#include "Memory/FrameZone.h"
+#include "NUMA.h"
+#include "Result.h"
+
+/// The highest supported block order, 2^18 frames make up a single 1 GiB block.
+constexpr usz BUDDY_MAX_ORDER = 18;
+/// The order of a single 2 MiB block.
+constexpr usz BUDDY_2MIB_ORDER = 9;
+
+/// The number of frames (256 MiB) made available by `BuddyFrameAllocatorInit`, enough to get through the boot process.
+constexpr usz BUDDY_BOOT_FRAMES = 65536;
+
+/// Marks a frame as the first one of an unallocated block, the lower bits contain the block's order.
+constexpr u8 BUDDY_FRAME_FREE = 1 << 7;
+
+/// A node of a block free list, stored inside the block's first frame itself.
+typedef struct BuddyFreeBlock {
+	struct BuddyFreeBlock* Previous;
+	struct BuddyFreeBlock* Next;
+} BuddyFreeBlock;
+
+/// A physical frame allocator based on the binary buddy system.
+/// Every block consists of 2^order naturally aligned frames and gets merged with its buddy on deallocation.
+typedef struct BuddyFrameAllocator {
+	MemoryMapEntry* MemoryMap;
+	usz MemoryMapEntries;
+	/// Contains a single byte per frame, describing the state of the block beginning at that frame.
+	u8* FrameOrders;
+	/// Every zone of every NUMA node has its own free lists.
+	/// The largest blocks are just as aligned as zone boundaries, so no block ever spans two zones,
+	/// and blocks are never merged across NUMA range boundaries, so no block ever spans two nodes either.
+	BuddyFreeBlock* FreeLists[MAX_NUMA_NODES][FRAME_ZONE_COUNT][BUDDY_MAX_ORDER + 1];
+	/// The number of free blocks of every order, across all of the free lists.
+	usz FreeBlocks[BUDDY_MAX_ORDER + 1];
+	/// The number of frames of every zone present in the memory map.
+	usz TotalFrames[FRAME_ZONE_COUNT];
+	/// The number of unallocated frames of every zone.
+	usz FreeFrames[FRAME_ZONE_COUNT];
+	Frame4KiB LastFrame;
+	/// The memory map entry and the frame in it where freeing the deferred part of the memory map continues.
+	usz DeferredEntry;
+	Frame4KiB DeferredFrame;
+	/// The number of frames still waiting for `BuddyFreeDeferredFrames`.
+	usz DeferredFrames;
+} BuddyFrameAllocator;
+
+/// Initializes the buddy allocator, using the first memory map entry for its metadata.
+/// Only the part of physical memory accessible through the physical memory mapping gets managed.
+/// Only the first `BUDDY_BOOT_FRAMES` frames of the memory map get freed right away,
+/// the rest has to be freed with `BuddyFreeDeferredFrames`.
+Result BuddyFrameAllocatorInit(BuddyFrameAllocator* frameAllocator, MemoryMapEntry* memoryMap, usz memoryMapEntries);
+/// Frees up to the given number of the memory map frames left out by `BuddyFrameAllocatorInit`.
+/// Returns the number of frames freed, zero once the whole memory map is available.
+usz BuddyFreeDeferredFrames(BuddyFrameAllocator* frameAllocator, usz maxFrames);
+
+/// Allocates a single block of 2^order contiguous, naturally aligned 4 KiB memory frames from the given zone of the given NUMA node.
+Result BuddyAllocateBlock(BuddyFrameAllocator* frameAllocator, u8 node, FrameZone zone, usz order, Frame4KiB* frame);
+/// Deallocates a single block of 2^order contiguous 4 KiB memory frames, merging it with its free buddies.
+Result BuddyDeallocateBlock(BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz order);
+
+/// Allocates a single 4 KiB memory frame from the given zone of the given NUMA node.
+Result BuddyAllocateFrame(BuddyFrameAllocator* frameAllocator, u8 node, FrameZone zone, Frame4KiB* frame);
+/// Allocates a contiguous range of 4 KiB memory frames from the given zone of the given NUMA node,
+/// the unused tail of the block is given back immediately.
+Result BuddyAllocateContiguousFrames(BuddyFrameAllocator* frameAllocator, u8 node, FrameZone zone, usz count, Frame4KiB* frame);
+/// Deallocates a single 4 KiB memory frame.
+void BuddyDeallocateFrame(BuddyFrameAllocator* frameAllocator, Frame4KiB frame);
+/// Deallocates a contiguous range of 4 KiB memory frames.
+Result BuddyDeallocateContiguousFrames(BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz count);
+/// Counts every free block in a histogram, bucket `i` counting blocks of 2^i frames, the last bucket also counting all of the larger ones.
+/// Free neighbouring blocks which aren't buddies get counted separately, so this is a lower bound of the actual runs of free frames.
+void BuddyFreeRunHistogram(const BuddyFrameAllocator* frameAllocator, usz* runs, usz buckets, usz* largestRun);
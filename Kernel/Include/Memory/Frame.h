@@ -11,3 +11,17 @@ constexpr u64 FRAME_4KIB_SIZE_BYTES = 4096;
 static inline Frame4KiB Frame4KiBContaining(PhysAddr address) { return __builtin_align_down(address, FRAME_4KIB_SIZE_BYTES); }
 static inline Frame4KiB Frame4KiBNext(PhysAddr address) { return __builtin_align_up(address, FRAME_4KIB_SIZE_BYTES); }
 static inline bool Frame4KiBAlignCheck(PhysAddr address) { return __builtin_is_aligned(address, FRAME_4KIB_SIZE_BYTES); }
+
+/// Represents a 2 MiB physical memory frame, backing a single 2 MiB page.
+typedef u64 Frame2MiB;
+
+constexpr u64 FRAME_2MIB_SIZE_BYTES = 2 * 1024 * 1024;
+
+static inline bool Frame2MiBAlignCheck(PhysAddr address) { return __builtin_is_aligned(address, FRAME_2MIB_SIZE_BYTES); }
+
+/// Represents a 1 GiB physical memory frame, backing a single 1 GiB page.
+typedef u64 Frame1GiB;
+
+constexpr u64 FRAME_1GIB_SIZE_BYTES = 1024 * 1024 * 1024;
+
+static inline bool Frame1GiBAlignCheck(PhysAddr address) { return __builtin_is_aligned(address, FRAME_1GIB_SIZE_BYTES); }
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "CPUInfo.h"
+#include "Core.h"
+#include "Memory.h"
+#include "Memory/BitmapFrameAllocator.h"
+#include "Memory/BuddyFrameAllocator.h"
+#include "Memory/Frame.h"
+#include "Memory/FrameInfo.h"
+#include "Memory/FrameZone.h"
+#include "Result.h"
+
+/// The physical memory engine backing the frame allocator, chosen once at boot.
+typedef enum FrameAllocatorEngine : u8 { FrameAllocatorBitmap = 0, FrameAllocatorBuddy } FrameAllocatorEngine;
+
+/// The number of frames a single magazine can hold.
+constexpr usz FRAME_MAGAZINE_CAPACITY = 64;
+/// The number of frames moved between a magazine and the engine at once.
+constexpr usz FRAME_MAGAZINE_BATCH = 32;
+
+/// A per-CPU stack of free frames, serving most single frame allocations without touching the engine.
+typedef struct FrameMagazine {
+	Frame4KiB Frames[FRAME_MAGAZINE_CAPACITY];
+	usz Count;
+	/// Allocations served straight from the magazine.
+	u64 Hits;
+	/// Allocations that had to refill the magazine from the engine first.
+	u64 Misses;
+} FrameMagazine;
+
+/// The number of frames (64 MiB) made available by a single `FreeDeferredFrames` call.
+constexpr usz DEFERRED_FRAMES_BATCH = 16384;
+
+/// The number of already zeroed frames kept around for `AllocateZeroedFrame`.
+constexpr usz ZEROED_FRAME_POOL_CAPACITY = 256;
+
+/// A stack of frames zeroed ahead of time, while the processor had nothing better to do.
+typedef struct ZeroedFramePool {
+	Frame4KiB Frames[ZEROED_FRAME_POOL_CAPACITY];
+	usz Count;
+	/// Allocations served straight from the pool.
+	u64 Hits;
+	/// Allocations that had to zero a frame on the spot.
+	u64 Misses;
+} ZeroedFramePool;
+
+/// The kernel's physical frame allocator, dispatching every call to the selected engine.
+typedef struct FrameAllocator {
+	FrameAllocatorEngine Engine;
+	BitmapFrameAllocator Bitmap;
+	BuddyFrameAllocator Buddy;
+	FrameMagazine Magazines[MAX_CPUS];
+	ZeroedFramePool ZeroedFrames;
+	/// The tag given to the frames allocated by every CPU, see `FrameAllocatorSetTag`.
+	FrameTag Tags[MAX_CPUS];
+	/// The number of allocated frames carrying every tag.
+	u64 TaggedFrames[FRAME_TAG_COUNT];
+} FrameAllocator;
+
+/// The number of buckets in the free run histogram, the last one (2^18 frames) covers runs of 1 GiB and longer.
+constexpr usz FRAME_RUN_HISTOGRAM_BUCKETS = 19;
+
+/// A snapshot of the physical memory usage, shared with userspace through a syscall, so it only contains plain 64-bit fields.
+typedef struct FrameStatistics {
+	/// The number of frames of every zone present in the memory map.
+	u64 TotalFrames[FRAME_ZONE_COUNT];
+	/// The number of frames of every zone available to the engine.
+	u64 FreeFrames[FRAME_ZONE_COUNT];
+	/// Free frames held by the magazines and the zeroed frame pool, which the engine counts as allocated.
+	u64 CachedFrames;
+	/// Frames of the memory map not made available yet, see `FreeDeferredFrames`.
+	u64 DeferredFrames;
+	/// Bucket `i` counts runs of 2^i up to 2^(i+1) - 1 contiguous free frames.
+	u64 FreeRuns[FRAME_RUN_HISTOGRAM_BUCKETS];
+	u64 LargestFreeRun;
+	/// The number of allocated frames carrying every `FrameTag`.
+	u64 TaggedFrames[FRAME_TAG_COUNT];
+} FrameStatistics;
+
+/// Initializes the chosen physical memory engine based on the memory map passed by the bootloader.
+Result FrameAllocatorInit(FrameAllocator* frameAllocator, FrameAllocatorEngine engine, MemoryMapEntry* memoryMap, usz memoryMapEntries);
+
+/// Allocates a single 4 KiB memory frame, taking it from the current CPU's magazine when possible.
+/// Magazines are refilled from the normal zone of the CPU's own NUMA node first, so low memory is left for devices which need it.
+Frame4KiB AllocateFrame(FrameAllocator* frameAllocator);
+/// Allocates a single 4 KiB memory frame filled with zeroes, taking it from the zeroed frame pool when possible.
+Frame4KiB AllocateZeroedFrame(FrameAllocator* frameAllocator);
+/// Zeroes a single frame and puts it in the zeroed frame pool, meant to be called repeatedly while idle.
+/// Returns false when the pool is already full or there is no free memory left to take from.
+bool RefillZeroedFrame(FrameAllocator* frameAllocator);
+/// Makes another batch of the memory left out during boot available, meant to be called repeatedly while idle.
+/// Allocations which would fail otherwise free the deferred memory on their own, so calling it is never required.
+/// Returns false once there is nothing left to free.
+bool FreeDeferredFrames(FrameAllocator* frameAllocator);
+/// Allocates a single 4 KiB memory frame from the given zone or one of the zones below it, bypassing the magazines.
+/// The current CPU's NUMA node is preferred, with the other nodes tried in order of their distance.
+Result AllocateFrameInZone(FrameAllocator* frameAllocator, FrameZone zone, Frame4KiB* frame);
+/// Same as `AllocateFrameInZone`, but preferring the given NUMA node instead of the current CPU's one.
+Result AllocateFrameOnNode(FrameAllocator* frameAllocator, u8 node, FrameZone zone, Frame4KiB* frame);
+/// Allocates a contiguous range of 4 KiB memory frames, preferring the normal zone so low memory is left for devices which need it.
+Result AllocateContiguousFrames(FrameAllocator* frameAllocator, usz count, Frame4KiB* frame);
+/// Allocates a contiguous range of 4 KiB memory frames from the given zone or one of the zones below it.
+Result AllocateContiguousFramesInZone(FrameAllocator* frameAllocator, FrameZone zone, usz count, Frame4KiB* frame);
+/// Same as `AllocateContiguousFrames`, but the first frame is aligned to the given power of two number of bytes,
+/// e.g. to back a huge page.
+Result AllocateAlignedContiguousFrames(FrameAllocator* frameAllocator, usz count, usz alignment, Frame4KiB* frame);
+/// Deallocates a single 4 KiB memory frame, putting it in the current CPU's magazine if it belongs to the CPU's NUMA node.
+/// Frames without any references are refused with a warning, as they must have already been deallocated.
+void DeallocateFrame(FrameAllocator* frameAllocator, Frame4KiB frame);
+/// Deallocates a contiguous range of 4 KiB memory frames.
+Result DeallocateContiguousFrames(FrameAllocator* frameAllocator, Frame4KiB frame, usz count);
+/// Logs the hit and miss counters of the zeroed frame pool and of every CPU that has used its magazine.
+void FrameAllocatorPrintMagazines(FrameAllocator* frameAllocator);
+/// Sets the tag given to every frame the current CPU allocates from now on, returning the previous one so it can be restored.
+FrameTag FrameAllocatorSetTag(FrameAllocator* frameAllocator, FrameTag tag);
+/// Changes the tag of already allocated frames.
+void FrameAllocatorRetag(FrameAllocator* frameAllocator, Frame4KiB frame, usz count, FrameTag tag);
+/// Takes a snapshot of the physical memory usage.
+/// Walks the whole bitmap when using the bitmap engine, so it's not meant to be called often.
+void FrameAllocatorGetStatistics(FrameAllocator* frameAllocator, FrameStatistics* statistics);
+/// Logs a snapshot of the physical memory usage.
+void FrameAllocatorPrintStatistics(FrameAllocator* frameAllocator);
+
+extern FrameAllocator g_frameAllocator;
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Core.h"
+#include "Memory/Frame.h"
+
+typedef enum FrameInfoFlags : u32 {
+	/// The frame holds a page table.
+	FrameInfoPageTable = 1 << 0,
+	/// The frame is mapped into more than a single address space.
+	FrameInfoShared = 1 << 1,
+	/// The frame is mapped read-only and has to be copied before the first write to it.
+	FrameInfoCopyOnWrite = 1 << 2,
+	/// The frame caches a part of a file.
+	FrameInfoPageCache = 1 << 3,
+} FrameInfoFlags;
+
+/// The subsystem a frame was allocated for, used only for the memory statistics.
+typedef enum FrameTag : u8 {
+	FrameTagUntagged = 0,
+	FrameTagPageTable,
+	FrameTagAHCI,
+	FrameTagScheduler,
+	FrameTagELF,
+	FrameTagFileSystem,
+	FrameTagSharedMemory,
+} FrameTag;
+
+constexpr usz FRAME_TAG_COUNT = 7;
+
+/// Describes a single physical frame, kept small so two of them fit in a cache line.
+/// Only allocated frames have meaningful metadata, it gets reset every time the frame allocator hands a frame out.
+typedef struct FrameInfo {
+	/// The number of references to the frame, it's given back to the frame allocator when the last one is put.
+	u32 ReferenceCount;
+	/// The number of page table entries mapping the frame.
+	u32 MapCount;
+	FrameInfoFlags Flags;
+	FrameTag Tag;
+	u8 Reserved[3];
+	/// Whatever the frame belongs to, e.g. a process, a shared memory object or a file.
+	void* Owner;
+	/// The frame's position inside of its owner, e.g. the page index in a file.
+	u64 Index;
+} FrameInfo;
+
+_Static_assert(sizeof(FrameInfo) == 32, "FrameInfo must stay 32 bytes");
+
+/// Contains a `FrameInfo` for every frame up to the last one in the memory map, placed by the frame allocator's engine.
+extern FrameInfo* g_frameInfos;
+extern usz g_frameInfoCount;
+
+/// Returns the number of bytes needed for the metadata of every frame up to the given one.
+static inline usz FrameInfoBytes(Frame4KiB lastFrame) { return ((lastFrame / FRAME_4KIB_SIZE_BYTES) + 1) * sizeof(FrameInfo); }
+
+/// Sets up the metadata array in the given memory, which must be at least `FrameInfoBytes` large.
+/// The memory isn't cleared, which would take time proportional to the amount of RAM,
+/// the engines clear the metadata of the memory map's frames with `FrameInfoClear` as they make them available instead.
+void FrameInfoInit(void* storage, Frame4KiB lastFrame);
+/// Clears the metadata of a range of frames, leaving them without any references.
+void FrameInfoClear(Frame4KiB frame, usz count);
+
+/// Returns the metadata of the given frame.
+static inline FrameInfo* FrameInfoOf(Frame4KiB frame) { return &g_frameInfos[frame / FRAME_4KIB_SIZE_BYTES]; }
+
+/// Resets the metadata of a freshly allocated frame, leaving it with a single reference.
+static inline void FrameInfoReset(Frame4KiB frame, FrameTag tag) { *FrameInfoOf(frame) = (FrameInfo) { .ReferenceCount = 1, .Tag = tag }; }
+
+/// Takes another reference to an allocated frame.
+void FrameGet(Frame4KiB frame);
+/// Drops a reference to an allocated frame, deallocating it once no references are left.
+/// Returns true if the frame got deallocated.
+bool FramePut(Frame4KiB frame);
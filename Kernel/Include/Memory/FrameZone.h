@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Core.h"
+#include "Memory/Frame.h"
+#include "Memory/PhysAddr.h"
+
+/// Physical memory zones, ordered from the most constrained one.
+/// A frame from a lower zone satisfies the constraints of every zone above it, so allocations can always fall back downwards.
+typedef enum FrameZone : u8 {
+	/// Memory below 4 GiB, reachable by devices limited to 32-bit DMA.
+	FrameZoneDMA32 = 0,
+	/// Everything else.
+	FrameZoneNormal
+} FrameZone;
+
+constexpr usz FRAME_ZONE_COUNT = 2;
+
+/// The first physical address past the DMA32 zone.
+/// Zone boundaries are kept 1 GiB aligned, so no 1 GiB naturally aligned range of frames ever spans two zones.
+constexpr PhysAddr FRAME_ZONE_DMA32_END = 0x100000000;
+
+/// Returns the zone the given frame belongs to.
+static inline FrameZone FrameZoneContaining(Frame4KiB frame) { return frame < FRAME_ZONE_DMA32_END ? FrameZoneDMA32 : FrameZoneNormal; }
+
+/// Returns the first frame of the given zone.
+static inline Frame4KiB FrameZoneFirstFrame(FrameZone zone) { return zone == FrameZoneDMA32 ? 0 : FRAME_ZONE_DMA32_END; }
+
+/// Returns the last frame of the given zone.
+static inline Frame4KiB FrameZoneLastFrame(FrameZone zone)
+{
+	return zone == FrameZoneDMA32 ? FRAME_ZONE_DMA32_END - FRAME_4KIB_SIZE_BYTES : Frame4KiBContaining(U64_MAX);
+}
+
+/// Returns how many frames of the given range (inclusive) belong to the given zone.
+static inline usz FrameZoneFramesInRange(FrameZone zone, Frame4KiB firstFrame, Frame4KiB lastFrame)
+{
+	if (firstFrame < FrameZoneFirstFrame(zone)) {
+		firstFrame = FrameZoneFirstFrame(zone);
+	}
+
+	if (lastFrame > FrameZoneLastFrame(zone)) {
+		lastFrame = FrameZoneLastFrame(zone);
+	}
+
+	return firstFrame > lastFrame ? 0 : ((lastFrame - firstFrame) / FRAME_4KIB_SIZE_BYTES) + 1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Core.h"
+#include "Memory/SlabCache.h"
+#include "Result.h"
+
+/// The size classes go from 8 bytes up to 2 KiB, doubling every time.
+constexpr usz HEAP_SIZE_CLASS_COUNT = 9;
+constexpr usz HEAP_SMALLEST_SIZE_CLASS_BYTES = 8;
+constexpr usz HEAP_LARGEST_SIZE_CLASS_BYTES = HEAP_SMALLEST_SIZE_CLASS_BYTES << (HEAP_SIZE_CLASS_COUNT - 1);
+
+typedef struct HeapSizeClass {
+	SlabCache Cache;
+	u64 Allocations;
+	u64 Deallocations;
+} HeapSizeClass;
+
+/// The kernel's general purpose heap, small allocations are rounded up to a size class and taken from its slab cache,
+/// larger ones get their own pages from `g_kernelMemoryAllocator`.
+typedef struct KernelHeap {
+	HeapSizeClass SizeClasses[HEAP_SIZE_CLASS_COUNT];
+	u64 LargeAllocations;
+	u64 LargeDeallocations;
+	/// The number of bytes currently held by large allocations, rounded up to whole pages.
+	usz LargeBytes;
+} KernelHeap;
+
+Result InitKernelHeap(KernelHeap* heap);
+
+/// These functions should be called only when the interrupt flag is cleared. It can be set afterwards.
+
+/// Allocates at least the given number of bytes, aligned to at least 8 bytes.
+Result HeapAllocate(KernelHeap* heap, usz sizeBytes, void** allocation);
+/// Deallocates memory allocated with `HeapAllocate`, the size has to be the same as the one it was allocated with.
+Result HeapDeallocate(KernelHeap* heap, void* allocation, usz sizeBytes);
+
+void HeapPrintStatistics(KernelHeap* heap);
+
+extern KernelHeap g_kernelHeap;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Core.h"
+#include "Memory/Page.h"
+#include "Memory/PageTable.h"
+#include "Memory/RangeTree.h"
+#include "Memory/SlabCache.h"
+#include "Memory/VirtAddr.h"
+#include "Result.h"
+
+/// What the memory of a mapped region comes from.
+typedef enum MappedRegionBacking : u8 {
+	/// Zeroed memory.
+	MappedRegionAnonymous = 1,
+	/// Memory filled with a file's contents, e.g. an ELF segment or a mapped file.
+	MappedRegionFile,
+	/// A shared memory object's frames.
+	MappedRegionShared,
+	/// A thread's stack.
+	MappedRegionStack,
+} MappedRegionBacking;
+
+/// A node of the tree of an address space's mapped regions.
+typedef struct MappedRegion {
+	RangeTreeNode Node;
+	/// The flags the region's pages are meant to have, individual entries may differ, e.g. while they're shared copy-on-write.
+	PageTableEntryFlags Flags;
+	MappedRegionBacking Backing;
+} MappedRegion;
+
+/// Describes everything mapped into an address space, complementing its `VirtualMemoryAllocator` which tracks the unused parts.
+typedef struct MappedRegionTree {
+	/// The mapped regions, ordered by their addresses.
+	RangeTree Regions;
+	SlabCache RegionCache;
+} MappedRegionTree;
+
+/// Initializes an empty tree, its nodes are kept in a slab cache which grows and shrinks with them.
+Result InitMappedRegionTree(MappedRegionTree* tree);
+/// Gives back the memory of all of the tree's nodes.
+void MappedRegionTreeRelease(MappedRegionTree* tree);
+/// Records a new mapped region, which must not overlap any of the already recorded ones.
+Result MappedRegionAdd(MappedRegionTree* tree, Page4KiB begin, Page4KiB end, PageTableEntryFlags flags, MappedRegionBacking backing);
+/// Forgets the mapped region beginning at the given page.
+Result MappedRegionRemove(MappedRegionTree* tree, Page4KiB begin);
+/// Returns the mapped region containing the given address, or `nullptr` if there's none.
+MappedRegion* MappedRegionFind(const MappedRegionTree* tree, VirtAddr address);
+/// Replaces the destination's regions with copies of the source's ones.
+Result MappedRegionTreeCopy(MappedRegionTree* destination, const MappedRegionTree* source);
@@ -3,6 +3,7 @@
 #include "Core.h"
 #include "Memory/Frame.h"
 #include "Memory/PageTable.h"
+#include "Memory/TLB.h"
 #include "Memory/VirtAddr.h"
 #include "Result.h"
 
@@ -15,12 +16,91 @@ static inline Page4KiB Page4KiBContaining(VirtAddr address) { return __builtin_a
 static inline Page4KiB Page4KiBNext(VirtAddr address) { return __builtin_align_up(address, PAGE_4KIB_SIZE_BYTES); }
 static inline bool Page4KiBIsAligned(VirtAddr address) { return __builtin_is_aligned(address, PAGE_4KIB_SIZE_BYTES); }
 
+/// Represents a 2 MiB virtual memory page, mapped directly by a level 2 table's entry.
+typedef u64 Page2MiB;
+
+constexpr u64 PAGE_2MIB_SIZE_BYTES = 2 * 1024 * 1024;
+
+static inline Page2MiB Page2MiBContaining(VirtAddr address) { return __builtin_align_down(address, PAGE_2MIB_SIZE_BYTES); }
+static inline Page2MiB Page2MiBNext(VirtAddr address) { return __builtin_align_up(address, PAGE_2MIB_SIZE_BYTES); }
+static inline bool Page2MiBIsAligned(VirtAddr address) { return __builtin_is_aligned(address, PAGE_2MIB_SIZE_BYTES); }
+
+/// Represents a 1 GiB virtual memory page, mapped directly by a level 3 table's entry.
+typedef u64 Page1GiB;
+
+constexpr u64 PAGE_1GIB_SIZE_BYTES = 1024 * 1024 * 1024;
+
+static inline Page1GiB Page1GiBContaining(VirtAddr address) { return __builtin_align_down(address, PAGE_1GIB_SIZE_BYTES); }
+static inline Page1GiB Page1GiBNext(VirtAddr address) { return __builtin_align_up(address, PAGE_1GIB_SIZE_BYTES); }
+static inline bool Page1GiBIsAligned(VirtAddr address) { return __builtin_is_aligned(address, PAGE_1GIB_SIZE_BYTES); }
+
+/// Allocates an empty page table using the global frame allocator, marking the frame as one.
+Frame4KiB AllocatePageTable();
+
 /// Maps this virtual memory page to the given physical memory frame, using the global frame allocator if needed.
 /// Does not flush the TLB.
 Result Page4KiBMap(PageTableEntry* p4Table, Page4KiB page, Frame4KiB frame, PageTableEntryFlags flags);
-/// Clears the page table entry associated with this page.
+/// Clears the page table entry associated with this page, deallocating the user half tables it leaves empty.
 /// Does not flush the TLB.
-Result Page4KiBUnmap(const PageTableEntry* p4Table, Page4KiB page);
+Result Page4KiBUnmap(PageTableEntry* p4Table, Page4KiB page);
 /// Changes the given page's underlying frame and flags.
 /// Does not flush the TLB.
 Result Page4KiBRemap(PageTableEntry* p4Table, Page4KiB page, Frame4KiB frame, PageTableEntryFlags flags);
+
+/// Maps this 2 MiB virtual memory page to the given 2 MiB frame, using the global frame allocator if needed.
+/// Does not flush the TLB.
+Result Page2MiBMap(PageTableEntry* p4Table, Page2MiB page, Frame2MiB frame, PageTableEntryFlags flags);
+/// Clears the level 2 table's entry mapping this 2 MiB page, fails if the page isn't mapped by a single 2 MiB entry.
+/// Does not flush the TLB.
+Result Page2MiBUnmap(PageTableEntry* p4Table, Page2MiB page);
+/// Replaces the 2 MiB entry mapping this page with a level 1 table mapping the same frames with the same flags,
+/// so parts of it can be changed on their own. The translation stays the same, so the TLB doesn't have to be flushed.
+Result Page2MiBSplit(PageTableEntry* p4Table, Page2MiB page);
+
+/// Maps this 1 GiB virtual memory page to the given 1 GiB frame, using the global frame allocator if needed.
+/// Does not flush the TLB.
+Result Page1GiBMap(PageTableEntry* p4Table, Page1GiB page, Frame1GiB frame, PageTableEntryFlags flags);
+/// Clears the level 3 table's entry mapping this 1 GiB page, fails if the page isn't mapped by a single 1 GiB entry.
+/// Does not flush the TLB.
+Result Page1GiBUnmap(PageTableEntry* p4Table, Page1GiB page);
+/// Replaces the 1 GiB entry mapping this page with a level 2 table of 2 MiB entries mapping the same frames with the same flags.
+/// The translation stays the same, so the TLB doesn't have to be flushed.
+Result Page1GiBSplit(PageTableEntry* p4Table, Page1GiB page);
+
+/// Maps the given number of consecutive pages to consecutive frames, beginning at the given ones.
+/// Page tables are walked once for every level 1 table instead of once for every page.
+/// Does not flush the TLB.
+Result PageMapRange(PageTableEntry* p4Table, Page4KiB page, usz count, Frame4KiB frame, PageTableEntryFlags flags);
+/// Same as `PageMapRange`, but using 2 MiB pages wherever both the pages and the frames are aligned to them.
+/// Does not flush the TLB.
+Result PageMapRangeHuge(PageTableEntry* p4Table, Page4KiB page, usz count, Frame4KiB frame, PageTableEntryFlags flags);
+/// Maps the given number of consecutive pages, backing every one of them with a newly allocated (and optionally zeroed) frame.
+/// Does not flush the TLB.
+Result PageMapRangeAllocated(PageTableEntry* p4Table, Page4KiB page, usz count, PageTableEntryFlags flags, bool zeroed);
+/// Reserves the given number of consecutive pages without backing them, each of them gets a zeroed frame on its first access.
+/// Reserved pages are unmapped and protected just like mapped ones.
+Result PageReserveRange(PageTableEntry* p4Table, Page4KiB page, usz count, PageTableEntryFlags flags);
+/// Backs a reserved page with a zeroed frame, meant to be called when it gets accessed for the first time.
+/// Fails with `ResultNotFound` if the page isn't a reserved one.
+Result PageBackReserved(PageTableEntry* p4Table, Page4KiB page);
+/// Clears the page table entries of the given number of consecutive pages, optionally deallocating their frames.
+/// Huge pages lying entirely inside of the range are unmapped as a whole, the ones crossing its edges get split first.
+/// Tables of a process's user half that are left without any entries get deallocated.
+/// Does not flush the TLB, but records every removed mapping in the given gather, unless it's null.
+Result PageUnmapRange(PageTableEntry* p4Table, Page4KiB page, usz count, bool deallocateFrames, TLBGather* gather);
+/// Replaces the flags of the given number of consecutive, already mapped pages, keeping their frames.
+/// Huge pages are handled the same way as by `PageUnmapRange`.
+/// Does not flush the TLB, but records every changed mapping in the given gather, unless it's null.
+Result PageProtectRange(PageTableEntry* p4Table, Page4KiB page, usz count, PageTableEntryFlags flags, TLBGather* gather);
+/// Copies the user half of an address space into an empty one, sharing all of the user pages' frames between the two.
+/// Writeable pages become read-only in both of them until they're written to, which copies them, and get recorded in the gather.
+/// Shared memory objects' pages are the exception, they stay writeable and are seen by both address spaces.
+/// Huge pages get split, so only the written to 4 KiB pages ever have to be copied.
+void PageShareUserHalf(PageTableEntry* sourceP4Table, PageTableEntry* destinationP4Table, TLBGather* gather);
+/// Gives a copy-on-write page its own copy of the shared frame and makes it writeable, meant to be called on the first write to it.
+/// Fails with `ResultNotFound` if the page isn't a copy-on-write one. Does not flush the TLB.
+Result PageCopyShared(PageTableEntry* p4Table, Page4KiB page);
+/// Tears down the whole user half of a process's address space in a single pass, dropping a reference to every mapped frame
+/// and deallocating all of the tables below the level 4 one, runs of consecutive frames are given back together.
+/// The address space must not be loaded, its PCID has to be flushed before it gets reused.
+void PageReleaseUserHalf(PageTableEntry* p4Table);
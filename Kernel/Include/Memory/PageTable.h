@@ -12,6 +12,14 @@ typedef enum PageTableEntryFlags : u64 {
 	PageDirty = 1ULL << 6,
 	PageHugePage = 1ULL << 7,
 	PageGlobal = 1ULL << 8,
+	/// Ignored by the processor, marks a not present entry of a reserved page, which gets backed by a zeroed frame on first access.
+	PageLazy = 1ULL << 9,
+	/// Ignored by the processor, marks a read-only entry of a writeable page with a shared frame, copied on the first write.
+	PageCopyOnWrite = 1ULL << 10,
+	/// Ignored by the processor, marks an entry of a frame the frame allocator doesn't own, e.g. a ramdisk's, never deallocated.
+	PageBorrowed = 1ULL << 11,
+	/// Ignored by the processor, marks an entry of a shared memory object's frame, which stays writeable in every address space.
+	PageSharedMemory = 1ULL << 52,
 	PageNoExecute = 1ULL << 63,
 } PageTableEntryFlags;
 
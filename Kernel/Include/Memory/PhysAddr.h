@@ -5,3 +5,5 @@
 typedef u64 PhysAddr;
 
 static inline void* PhysAddrAsPointer(PhysAddr address) { return (void*)(address + g_bootInfo.PhysicalMemoryOffset); }
+/// The reverse of `PhysAddrAsPointer`, only valid for pointers into the physical memory mapping.
+static inline PhysAddr PointerAsPhysAddr(const void* pointer) { return (PhysAddr)pointer - g_bootInfo.PhysicalMemoryOffset; }
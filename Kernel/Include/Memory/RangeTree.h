@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Core.h"
+#include "Result.h"
+
+/// A node of an intrusive AVL tree of address ranges, ordered by their beginnings.
+/// It has to be the first member of whatever the tree holds, so a node can be cast to the structure containing it.
+typedef struct RangeTreeNode {
+	/// Inclusive
+	u64 Begin;
+	/// Exclusive
+	u64 End;
+	struct RangeTreeNode* Left;
+	struct RangeTreeNode* Right;
+	usz Height;
+} RangeTreeNode;
+
+/// Recomputes whatever the containing structure keeps about the node's subtree, e.g. the size of its largest range.
+/// It's called every time one of the node's subtrees changes, after its children and its own height have been updated.
+typedef void (*RangeTreeUpdateFunction)(RangeTreeNode* node);
+/// Called for every node of a tree in the order of their addresses, an error stops the walk.
+typedef Result (*RangeTreeWalkFunction)(const RangeTreeNode* node, void* context);
+
+typedef struct RangeTree {
+	RangeTreeNode* Root;
+	/// Optional, `nullptr` when the nodes don't keep anything about their subtrees.
+	RangeTreeUpdateFunction Update;
+} RangeTree;
+
+/// Initializes an empty tree, the nodes' memory is always up to the tree's user.
+void InitRangeTree(RangeTree* tree, RangeTreeUpdateFunction update);
+/// Links a node with its range already set into the tree, no other node may begin at the same address.
+void RangeTreeInsert(RangeTree* tree, RangeTreeNode* node);
+/// Unlinks the node beginning at the given address, returning it, or `nullptr` if there's none.
+RangeTreeNode* RangeTreeRemove(RangeTree* tree, u64 begin);
+/// Returns the node with the highest beginning not above the given address, or `nullptr` if there's none.
+RangeTreeNode* RangeTreeFloor(const RangeTree* tree, u64 address);
+/// Returns the node with the lowest beginning above the given address, or `nullptr` if there's none.
+RangeTreeNode* RangeTreeCeiling(const RangeTree* tree, u64 address);
+/// Calls the function for every node in the order of their addresses, returning the first error it returns.
+Result RangeTreeWalk(const RangeTree* tree, RangeTreeWalkFunction function, void* context);
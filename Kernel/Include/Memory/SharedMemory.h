@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Core.h"
+#include "Memory/Frame.h"
+#include "Memory/Page.h"
+#include "Memory/PageTable.h"
+#include "Memory/SizedBlockAllocator.h"
+#include "Result.h"
+#include "Scheduler.h"
+
+constexpr usz MAX_SHARED_MEMORY_OBJECTS = 64;
+constexpr usz MAX_SHARED_MEMORY_MAPPINGS = 32;
+constexpr usz SHARED_MEMORY_NAME_SIZE = 32;
+/// The largest object a process can ask for, the object's frames are allocated all at once.
+constexpr usz MAX_SHARED_MEMORY_SIZE = 0x1000000;
+
+/// A named piece of memory that can be mapped into any number of processes at once, writes to it are seen by all of them.
+typedef struct SharedMemoryObject {
+	/// Null-padded.
+	i8 Name[SHARED_MEMORY_NAME_SIZE];
+	/// The number of mappings of the object, it's destroyed along with the last one.
+	usz References;
+	usz PageCount;
+	/// The frames backing the object, one for each page, the object holds a reference to every one of them.
+	Frame4KiB* Frames;
+} SharedMemoryObject;
+
+/// A single mapping of a shared memory object, kept in the process that mapped it.
+typedef struct SharedMemoryMapping {
+	SharedMemoryObject* Object;
+	Page4KiB Begin;
+} SharedMemoryMapping;
+
+typedef struct SharedMemory {
+	SizedBlockAllocator Objects;
+} SharedMemory;
+
+Result InitSharedMemory(SharedMemory* sharedMemory);
+
+/// These functions should be called only when the interrupt flag is cleared. It can be set afterwards.
+
+/// Maps the shared memory object with the given name into the process's address space, creating a zeroed one if there isn't one yet.
+/// A size of 0 only maps an already existing object, otherwise the size must match the object's one.
+Result SharedMemoryMap(Process* process, const i8* name, usz sizeBytes, PageTableEntryFlags flags, void** mapping);
+/// Unmaps a mapping created with `SharedMemoryMap`, the object gets destroyed once it's unmapped everywhere.
+Result SharedMemoryUnmap(Process* process, void* mapping);
+/// Takes another reference to the object of every one of the source process's mappings, for its copy which inherits them.
+Result SharedMemoryCopyMappings(Process* destination, Process* source);
+/// Drops the references held by all of the process's mappings, without touching its page tables.
+void SharedMemoryReleaseMappings(Process* process);
+
+extern SharedMemory g_sharedMemory;
@@ -3,26 +3,31 @@
 #include "Core.h"
 #include "Result.h"
 
+/// Hands out fixed-size blocks from a fixed pool, keeping track of them with a bitmap of the used ones at the pool's beginning.
+/// The bitmap is followed by two summaries with a bit for every one of its words, so free and used blocks can be found
+/// a whole word of the summary at a time.
 typedef struct SizedBlockAllocator {
 	/// Inclusive.
 	u8* FirstBlock;
-	/// Inclusive.
-	u8* LastBlock;
 	u64* BlockBitmap;
+	/// The bitmap words with at least one free block.
+	u64* NonFullWords;
+	/// The bitmap words with at least one used block.
+	u64* NonEmptyWords;
 	usz PoolSizeBytes;
 	usz BlockSizeBytes;
 	usz AllocationCapacity;
 	usz AllocationCount;
-	usz NextToAllocate;
 } SizedBlockAllocator;
 
 /// Initializes the sized-block allocator. Expects a contiguous, mapped virtual memory region.
 Result InitSizedBlockAllocator(SizedBlockAllocator* blockAllocator, void* poolStart, usz poolSizeBytes, usz blockSizeBytes);
-/// Allocates a single memory block.
+/// Allocates a single memory block, always the lowest free one.
 Result SizedBlockAllocate(SizedBlockAllocator* blockAllocator, void** block);
 /// Deallocates a single memory block.
 Result SizedBlockDeallocate(SizedBlockAllocator* blockAllocator, void* block);
 /// Uses a `void*` to iterate on all the allocated sized blocks.
+/// The block the iterator points to may be deallocated before moving on to the next one.
 Result SizedBlockIterate(SizedBlockAllocator* blockAllocator, void** sizedBlockIterator);
 /// Uses a `void*` to iterate on all the allocated sized blocks in a circle,
 /// so when the end of the list is reached, it starts from the beginning.
@@ -41,3 +46,20 @@ static inline usz SizedBlockGetIndex(SizedBlockAllocator* blockAllocator, void*
 {
 	return ((u8*)address - blockAllocator->FirstBlock) / blockAllocator->BlockSizeBytes;
 }
+
+/// Returns the size of the bitmap and its two summaries for the given number of blocks.
+static inline usz SizedBlockMetadataSizeBytes(usz blockCount)
+{
+	const usz bitmapWordCount = (blockCount + 63) / 64;
+	const usz summaryWordCount = (bitmapWordCount + 63) / 64;
+
+	return (bitmapWordCount + (2 * summaryWordCount)) * sizeof(u64);
+}
+
+/// Returns the size a pool has to have to fit the given number of blocks along with the allocator's metadata.
+static inline usz SizedBlockPoolSizeBytes(usz blockSizeBytes, usz blockCount)
+{
+	const usz metadataBlocks = (SizedBlockMetadataSizeBytes(blockCount) + blockSizeBytes - 1) / blockSizeBytes;
+
+	return (metadataBlocks + blockCount) * blockSizeBytes;
+}
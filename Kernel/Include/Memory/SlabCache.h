@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Core.h"
+#include "Result.h"
+
+/// The most frames a single slab can span, large objects get bigger slabs so less of them goes to waste.
+constexpr usz SLAB_MAX_FRAMES = 8;
+
+/// The header at the beginning of every slab, one or more contiguous frames accessed through the physical memory mapping.
+typedef struct Slab {
+	struct Slab* Previous;
+	struct Slab* Next;
+	/// Free objects link to the next free one through their first bytes.
+	void* FreeObjects;
+	usz UsedObjects;
+} Slab;
+
+/// Hands out fixed-size objects from slabs taken straight from the frame allocator, growing and shrinking a slab at a time.
+/// Slabs of a single frame come from the CPU's magazine, larger ones are contiguous ranges aligned to their own size.
+/// Slabs don't need any virtual memory, so even the virtual memory allocators can keep their own nodes in one.
+typedef struct SlabCache {
+	/// Slabs with at least one free object, the ones at the front are used first.
+	Slab* PartialSlabs;
+	/// Slabs without any free objects.
+	Slab* FullSlabs;
+	usz ObjectSizeBytes;
+	usz ObjectsPerSlab;
+	usz FramesPerSlab;
+	usz SlabCount;
+	usz ObjectCount;
+} SlabCache;
+
+/// Initializes an empty cache, the objects have to be at least pointer-sized and leave room for the slab header in the largest slab.
+/// The slabs are made just large enough for the header and the space left over after the last object to take up at most an eighth of them.
+Result InitSlabCache(SlabCache* cache, usz objectSizeBytes);
+/// Allocates a single object, taking a new slab when all the other ones are full.
+Result SlabCacheAllocate(SlabCache* cache, void** object);
+/// Deallocates a single object, giving its slab back once it's empty, unless it's the last slab with free objects.
+void SlabCacheDeallocate(SlabCache* cache, void* object);
+/// Gives every slab back to the frame allocator, whether its objects are still used or not.
+void SlabCacheRelease(SlabCache* cache);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Core.h"
+#include "Memory/Frame.h"
+#include "Memory/VirtAddr.h"
+#include "Result.h"
+
+/// A process context identifier, tagging the TLB entries of an address space so they survive switching to another one.
+typedef u16 PCID;
+
+constexpr usz PCID_COUNT = 4096;
+/// Used by the kernel's own address space, and by every address space when PCIDs aren't supported.
+constexpr PCID KERNEL_PCID = 0;
+
+/// Makes read-only pages read-only for the kernel as well.
+constexpr u64 CR0_WP = 1ULL << 16;
+/// Keeps the TLB entries tagged with the PCID being loaded, instead of flushing them.
+constexpr u64 CR3_NO_FLUSH = 1ULL << 63;
+constexpr u64 CR4_PGE = 1ULL << 7;
+constexpr u64 CR4_PCIDE = 1ULL << 17;
+
+/// The lowest address of the kernel's half of every address space.
+constexpr VirtAddr KERNEL_HALF_BEGIN = 0xffff800000000000;
+/// The address right past the highest one of the user half of every address space.
+constexpr VirtAddr USER_HALF_END = 0x800000000000;
+
+typedef enum INVPCIDType : u8 {
+	INVPCIDAddress = 0,
+	INVPCIDSingleContext,
+	INVPCIDAllContextsGlobal,
+	INVPCIDAllContexts,
+} INVPCIDType;
+
+/// The number of pages above which flushing the whole address space is cheaper than invalidating the pages one by one.
+constexpr usz TLB_GATHER_MAX_PAGES = 32;
+
+/// Collects the pages of an address space whose mappings got changed or removed, so they can all be invalidated in a single step.
+typedef struct TLBGather {
+	PCID PCID;
+	/// The number of gathered pages, the addresses of only the first `TLB_GATHER_MAX_PAGES` of them are kept.
+	usz Count;
+	VirtAddr Pages[TLB_GATHER_MAX_PAGES];
+} TLBGather;
+
+typedef struct TLBState {
+	/// Kernel pages are global when supported, so their TLB entries survive address space switches.
+	bool GlobalPagesEnabled;
+	/// PCIDs are only used when `invpcid` is supported as well, as there is no other way to flush an address space not currently loaded.
+	bool PCIDEnabled;
+	/// A bit for every PCID in use, the kernel's one included.
+	u64 UsedPCIDs[PCID_COUNT / 64];
+} TLBState;
+
+/// Enables global pages and PCIDs if the processor supports them, must be called while the kernel's address space is loaded.
+void InitTLB();
+
+/// Hands out a PCID not used by any other address space, or `KERNEL_PCID` when PCIDs are disabled.
+Result PCIDAllocate(PCID* pcid);
+/// Flushes the TLB entries tagged with the given PCID and gives it back, so it can be reused by another address space.
+void PCIDFree(PCID pcid);
+
+extern TLBState g_tlb;
+
+/// Returns the value to load into CR3 to switch to the given address space, keeping its TLB entries from the last time it was loaded.
+static inline u64 TLBAddressSpaceCR3(Frame4KiB pml4, PCID pcid) { return g_tlb.PCIDEnabled ? pml4 | pcid | CR3_NO_FLUSH : pml4; }
+
+/// Sets the no-flush bit in a CR3 value read from the register, in which it always reads as clear.
+static inline u64 TLBNoFlushCR3(u64 cr3) { return g_tlb.PCIDEnabled ? cr3 | CR3_NO_FLUSH : cr3; }
+
+/// Invalidates the TLB entries of the page containing the given address in the given address space.
+/// Kernel pages are shared by every address space, so they get invalidated in all of them.
+void FlushPage(PCID pcid, VirtAddr address);
+/// Invalidates all of the given address space's TLB entries, or every TLB entry, global ones included,
+/// in the case of the kernel's address space.
+void FlushTLB(PCID pcid);
+
+/// Starts gathering the pages of the given address space.
+static inline void TLBGatherInit(TLBGather* gather, PCID pcid) { *gather = (TLBGather) { .PCID = pcid }; }
+
+/// Records a page whose mapping changed, a huge page only has to be recorded once, using any address inside of it.
+static inline void TLBGatherPage(TLBGather* gather, VirtAddr page)
+{
+	if (gather->Count < TLB_GATHER_MAX_PAGES) {
+		gather->Pages[gather->Count] = page;
+	}
+
+	gather->Count++;
+}
+
+/// Invalidates the gathered pages one by one, or the whole address space when too many of them were gathered, and starts over.
+/// Once other processors get brought up, this is where a single shootdown request per processor should be sent.
+void TLBGatherFlush(TLBGather* gather);
@@ -9,7 +9,10 @@ typedef u64 VirtAddr;
 
 constexpr u64 INDEX_MASK = ((1ULL << 9) - 1);
 constexpr u64 PAGE_OFFSET_MASK = 0xfff;
+constexpr u64 HUGE_PAGE_2MIB_OFFSET_MASK = (1ULL << 21) - 1;
+constexpr u64 HUGE_PAGE_1GIB_OFFSET_MASK = (1ULL << 30) - 1;
 
+/// Translates the given address using the given page tables, 2 MiB and 1 GiB pages included.
 Result VirtAddrToPhys(const PageTableEntry* p4Table, VirtAddr address, PhysAddr* physAddr);
 
 static inline u16 VirtAddrPageOffset(VirtAddr address) { return address & PAGE_OFFSET_MASK; }
@@ -2,33 +2,48 @@
 
 #include "Memory/Frame.h"
 #include "Memory/Page.h"
-#include "Memory/SizedBlockAllocator.h"
+#include "Memory/RangeTree.h"
+#include "Memory/SlabCache.h"
+#include "Memory/TLB.h"
 #include "Result.h"
 
+/// A node of the tree of unused regions.
 typedef struct UnusedVirtualRegion {
-	/// Inclusive
-	Page4KiB Begin;
-	/// Exclusive
-	Page4KiB End;
-	struct UnusedVirtualRegion* Previous;
-	struct UnusedVirtualRegion* Next;
+	RangeTreeNode Node;
+	/// The size of the largest region in this subtree, so searches can skip the subtrees without a large enough one.
+	usz LargestSize;
+	/// The combined size of all the regions in this subtree, used for picking a random one.
+	usz TotalSize;
 } UnusedVirtualRegion;
 
 typedef struct VirtualMemoryAllocator {
-	UnusedVirtualRegion* List;
-	SizedBlockAllocator ListBackingStorage;
+	/// The unused regions, ordered by their addresses.
+	RangeTree Regions;
+	SlabCache RegionCache;
 	Frame4KiB PML4;
+	/// The PCID of the address space, used for invalidating its TLB entries.
+	PCID PCID;
 } VirtualMemoryAllocator;
 
-/// Initializes the virtual memory manager, expects a contiguous region of backed virtual memory.
-Result InitVirtualMemoryAllocator(VirtualMemoryAllocator* allocator, void* listBeginning, usz listSize, Frame4KiB pml4);
+/// Initializes the virtual memory manager, its regions' nodes are kept in a slab cache which grows and shrinks with them.
+/// The address space's PCID is set to the kernel's one, other address spaces have to set their own.
+Result InitVirtualMemoryAllocator(VirtualMemoryAllocator* allocator, Frame4KiB pml4);
+/// Marks a randomly chosen virtual memory region of the given size as used, without mapping anything into it.
+Result AllocateVirtualRegion(VirtualMemoryAllocator* allocator, usz size, Page4KiB* pageBegin);
 /// Allocates the given amount of physical memory and maps it to a randomly chosen virtual memory region.
 Result AllocateBackedVirtualMemory(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, void** allocatedPage);
 /// Allocates the given amount of physical memory and maps it to the specified virtual address.
 Result AllocateBackedVirtualMemoryAtAddress(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, Page4KiB pageBegin);
+/// Reserves a randomly chosen virtual memory region, only backing its pages with zeroed frames once they get accessed.
+/// The memory is given back with `DeallocateBackedVirtualMemory`, just like eagerly backed memory.
+Result ReserveVirtualMemory(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, void** reservedPage);
+/// Same as `AllocateBackedVirtualMemory`, but the region is 2 MiB aligned and backed with 2 MiB pages wherever possible.
+/// The size has to be a multiple of 2 MiB, the memory is given back with `DeallocateBackedVirtualMemory` as usual.
+Result AllocateHugeBackedVirtualMemory(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, void** allocatedPage);
 /// Deallocates the given amount of physical memory and unmaps it from its corresponding virtual memory region.
 Result DeallocateBackedVirtualMemory(VirtualMemoryAllocator* allocator, void* allocatedMemory, usz size);
 /// Maps the given amount of physical memory to a randomly chosen virtual memory region.
+/// Regions of at least 2 MiB are mapped with 2 MiB pages wherever the physical memory's alignment allows it.
 Result AllocateMMIORegion(VirtualMemoryAllocator* allocator, Frame4KiB begin, usz size, PageTableEntryFlags flags, void** mmioBegin);
 /// Deallocates the given amount of virtual memory.
 Result DeallocateMMIORegion(VirtualMemoryAllocator* allocator, void* mmioBegin, usz size);
@@ -36,11 +51,13 @@ Result DeallocateMMIORegion(VirtualMemoryAllocator* allocator, void* mmioBegin,
 Result MarkVirtualMemoryUsed(VirtualMemoryAllocator* allocator, Page4KiB begin, Page4KiB end);
 /// Just marks the given virtual memory region as unused, where `begin` is inclusive and `end` exclusive.
 Result MarkVirtualMemoryUnused(VirtualMemoryAllocator* allocator, Page4KiB begin, Page4KiB end);
+/// Replaces the destination's unused regions with the source's ones, without touching either address space's page tables.
+Result CopyVirtualMemoryRegions(VirtualMemoryAllocator* destination, const VirtualMemoryAllocator* source);
 
 Result RemapVirtualMemory(VirtualMemoryAllocator* allocator, Page4KiB begin, usz size, PageTableEntryFlags flags);
 
 /// Populates the given number of the top kernel PML4's entries and initializes the memory manager.
-Result InitKernelVirtualMemory(usz topPML4Entries, Page4KiB backingMemoryBegin, usz backingMemorySize);
+Result InitKernelVirtualMemory(usz topPML4Entries);
 
 void VirtualMemoryPrintRegions(VirtualMemoryAllocator* allocator);
 
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CPUInfo.h"
+#include "Core.h"
+#include "Memory/PhysAddr.h"
+#include "Result.h"
+
+constexpr usz MAX_NUMA_NODES = 8;
+constexpr usz MAX_NUMA_MEMORY_RANGES = 32;
+
+/// The distance the ACPI specification defines between a node and itself, also assumed between any two nodes without a SLIT.
+constexpr u8 NUMA_LOCAL_DISTANCE = 10;
+constexpr u8 NUMA_REMOTE_DISTANCE = 20;
+
+/// A range of physical memory attached to a single node.
+typedef struct NUMAMemoryRange {
+	PhysAddr Begin;
+	/// Exclusive.
+	PhysAddr End;
+	u8 Node;
+} NUMAMemoryRange;
+
+/// A processor's affinity, as described by the SRAT.
+typedef struct NUMAProcessor {
+	u32 APICID;
+	u8 Node;
+} NUMAProcessor;
+
+typedef struct NUMATopology {
+	usz NodeCount;
+	/// Sorted by address and covering the whole physical address space,
+	/// memory missing from the SRAT is assigned to the node of the range right before it.
+	NUMAMemoryRange MemoryRanges[MAX_NUMA_MEMORY_RANGES];
+	usz MemoryRangeCount;
+	NUMAProcessor Processors[MAX_CPUS];
+	usz ProcessorCount;
+	/// The node of every logical processor, indexed by `CPUCurrentIndex`.
+	u8 CPUNodes[MAX_CPUS];
+	u8 Distances[MAX_NUMA_NODES][MAX_NUMA_NODES];
+	/// For every node, all of the nodes sorted from the closest one (the node itself) to the furthest one.
+	u8 FallbackOrder[MAX_NUMA_NODES][MAX_NUMA_NODES];
+} NUMATopology;
+
+/// Reads the SRAT and SLIT ACPI tables, when there is no SRAT the whole machine is treated as a single node.
+/// Must be called after `InitXSDT` and before any physical memory gets allocated.
+Result InitNUMA();
+
+/// Returns the memory range the given physical address belongs to.
+const NUMAMemoryRange* NUMARangeContaining(PhysAddr address);
+
+/// Returns the node the given physical address belongs to.
+static inline u8 NUMANodeContaining(PhysAddr address) { return NUMARangeContaining(address)->Node; }
+
+extern NUMATopology g_numa;
+
+/// Returns the node of the logical processor executing this code.
+static inline u8 NUMACurrentNode() { return g_numa.CPUNodes[CPUCurrentIndex()]; }
@@ -5,6 +5,8 @@
 typedef struct KernelParams {
 	const i8* InitProcess;
 	bool ASLR;
+	/// Use the buddy allocator as the physical memory engine instead of the bitmap one.
+	bool BuddyAllocator;
 } KernelParams;
 
 void ParseKernelParams();
@@ -3,7 +3,9 @@
 #include "Core.h"
 #include "InterruptHandlers.h"
 #include "Memory/Frame.h"
+#include "Memory/MappedRegionTree.h"
 #include "Memory/SizedBlockAllocator.h"
+#include "Memory/TLB.h"
 #include "Memory/VirtualMemoryAllocator.h"
 
 constexpr usz MAX_THREADS_PER_PROCESS = 64;
@@ -60,14 +62,20 @@ typedef struct Thread {
 typedef struct Process {
 	usz ID;
 	Frame4KiB PML4;
+	/// Tags the process's TLB entries, so they don't have to be flushed on every switch to another process.
+	PCID PCID;
 	/// Maximum of 64 threads per process.
 	Thread* Threads[64];
 	Thread* MainThread;
 	usz ThreadCount;
 	VirtualMemoryAllocator VirtualMemoryAllocator;
+	/// Everything mapped into the process's address space, consulted by the page fault handler.
+	MappedRegionTree MappedRegions;
 	/// A list of files opened by the process.
 	SizedBlockAllocator FileDescriptors;
 	SizedBlockAllocator ELFSegmentMap;
+	/// The shared memory objects mapped into the process, see `SharedMemoryMapping`.
+	SizedBlockAllocator SharedMemoryMappings;
 } Process;
 
 typedef struct Scheduler {
@@ -76,10 +84,18 @@ typedef struct Scheduler {
 	Thread* CurrentThread;
 } Scheduler;
 
+/// `CURRENT_THREAD_OFFSET` in the scheduler and syscall handlers relies on it.
+_Static_assert(__builtin_offsetof(Scheduler, CurrentThread) == 128, "Scheduler.CurrentThread must stay at offset 128");
+
 Result InitScheduler();
 
 /// This functions should be called only when the interrupt flag is cleared. It can be set afterwards.
 Result ProcessCreate(Process** createdProcess);
+/// Creates a copy of the thread's process, sharing all of its userspace memory until either of them writes to it.
+/// The copy's main thread starts with the given context, on the copy of the thread's user stack.
+/// Only the given thread and the address space are copied, the other threads and file descriptors aren't.
+/// This functions should be called only when the interrupt flag is cleared. It can be set afterwards.
+Result ProcessFork(const Thread* thread, const CPUContext* context, Process** createdProcess);
 /// This functions should be called only when the interrupt flag is cleared. It can be set afterwards.
 Result ProcessTerminateStart(Process* process);
 /// This functions should be called only when the interrupt flag is cleared. It can be set afterwards.
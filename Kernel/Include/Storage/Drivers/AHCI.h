@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Core.h"
+#include "Memory/Frame.h"
+#include "Memory/FrameZone.h"
 #include "Memory/PhysAddr.h"
 #include "Result.h"
 
@@ -170,6 +172,8 @@ Result AHCIDeviceWriteSectors(AHCIDevice* device, usz startSectorIndex, usz sect
 typedef struct AHCIDriver {
 	/// PCI BAR 5
 	HBARegisters* Registers;
+	/// The highest zone the controller can reach, controllers without 64-bit addressing are limited to the DMA32 zone.
+	FrameZone DMAZone;
 
 	/// For now I only store one device (port), later I will implement multiple device support.
 	AHCIDevice Devices[1];
@@ -177,6 +181,9 @@ typedef struct AHCIDriver {
 
 Result AHCIReset(AHCIDriver* ahci);
 
+/// Allocates a contiguous range of frames the controller is able to transfer data to and from.
+Result AHCIAllocateDMAFrames(const AHCIDriver* ahci, usz count, Frame4KiB* frame);
+
 Result InitAHCI();
 
 extern AHCIDriver g_ahciDriver;
@@ -31,5 +31,7 @@ Result STFSFileRead(void* fileSystemSpecific, usz fileOffset, usz countBytes, vo
 Result STFSFileInformation(void* fileSystemSpecific, OpenedFileInformation* fileInformation);
 Result STFSFileClose(void* fileSystemSpecific);
 Result STFSFileLookupID(const i8* fileName, u64* id);
+/// Hands out the ramdisk's own frame for pages of the file that fill a whole page aligned in the ramdisk.
+Result STFSFileGetPage(void* fileSystemSpecific, usz fileOffset, Frame4KiB* frame);
 
 extern STFSDriver g_stfsDriver;
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Core.h"
+#include "Memory/Frame.h"
+#include "Memory/PageTable.h"
 #include "Memory/SizedBlockAllocator.h"
 #include "Result.h"
 
@@ -30,6 +32,10 @@ typedef struct MountpointFunctions {
 	Result (*FileInformation)(void* fileSystemSpecific, OpenedFileInformation* fileInformation);
 	Result (*FileClose)(void* fileSystemSpecific);
 	Result (*FileLookupID)(const i8* relativeFileName, u64* id);
+	/// Optional, hands out the frame holding a whole page of the file at the given page aligned offset, so it can be mapped directly.
+	/// The frame stays owned by the filesystem. When it fails, e.g. for pages not aligned in the underlying storage,
+	/// the page gets read into a new frame instead.
+	Result (*FileGetPage)(void* fileSystemSpecific, usz fileOffset, Frame4KiB* frame);
 } MountpointFunctions;
 
 typedef struct Mountpoint {
@@ -73,5 +79,11 @@ Result FileRead(usz fileDescriptor, usz countBytes, void* buffer);
 Result FileInformation(usz fileDescriptor, OpenedFileInformation* fileInformation);
 Result FileSetOffset(usz fileDescriptor, usz offset);
 Result FileClose(VirtualFileSystem* fileSystem, usz fileDescriptor);
+/// Maps the given page aligned part of the file into the current process's address space, zero-filling past the file's end.
+/// Pages the filesystem can hand out directly are shared, a writeable mapping is private and copies them on the first write.
+/// The mapping stays valid after the file gets closed.
+Result FileMap(usz fileDescriptor, usz offsetBytes, usz countBytes, PageTableEntryFlags flags, void** mapping);
+/// Unmaps a mapping created with `FileMap`.
+Result FileUnmap(void* mapping, usz countBytes);
 
 extern VirtualFileSystem g_virtualFileSystem;
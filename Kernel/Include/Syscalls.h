@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Core.h"
+#include "Memory/FrameAllocator.h"
 #include "Memory/VirtAddr.h"
 
 constexpr u32 MSR_EFER = 0xc0000080;
@@ -8,14 +9,45 @@ constexpr u32 MSR_STAR = 0xc0000081;
 constexpr u32 MSR_LSTAR = 0xc0000082;
 constexpr u32 MSR_SFMASK = 0xc0000084;
 
+/// `SyscallHandler.s` keeps its own copy, checked in `Syscalls.c`.
+constexpr usz SYSCALL_COUNT = 9;
+/// Returned by the fork syscall in place of a process ID.
+constexpr u64 PROCESS_FORK_FAILED = U64_MAX;
+
+/// The callee-saved registers the syscall handler doesn't save itself, in the order `ScProcessFork` pushes them.
+typedef struct SyscallPreservedRegisters {
+	u64 RBP;
+	u64 R12;
+	u64 R13;
+	u64 R14;
+	u64 R15;
+} SyscallPreservedRegisters;
+
 /// Syscall number 0.
 /// When passing in the ID of 0, the calling process will get terminated.
 void ScProcessTerminate(usz processID);
 Result ScPrint(const i8* text);
 Result ScTest();
+/// Copies a snapshot of the physical memory usage into the given userspace buffer.
+Result ScFrameStatistics(FrameStatistics* statistics);
+/// Maps the named shared memory object into the calling process, see `SharedMemoryMap`.
+/// The name is at most `SHARED_MEMORY_NAME_SIZE - 1` bytes long, the mapping's address is written to the given userspace pointer.
+Result ScSharedMemoryMap(const i8* name, usz sizeBytes, bool writeable, void** mapping);
+/// Unmaps a mapping created with `ScSharedMemoryMap` from the calling process.
+Result ScSharedMemoryUnmap(void* mapping);
+/// Maps a part of the calling process's opened file into its address space, see `FileMap`.
+/// The mapping's address is written to the given userspace pointer.
+Result ScFileMap(usz fileDescriptor, usz offsetBytes, usz countBytes, bool writeable, void** mapping);
+/// Unmaps a mapping created with `ScFileMap` from the calling process.
+Result ScFileUnmap(void* mapping, usz countBytes);
+/// Implemented in `SyscallHandler.s`, it passes the caller's registers on to `ScProcessForkWithRegisters`.
+void ScProcessFork();
+/// Copies the calling process, see `ProcessFork`, the copy starts off returning from the syscall just like the caller.
+/// Returns the copy's process ID in the caller and 0 in the copy, or `PROCESS_FORK_FAILED`.
+u64 ScProcessForkWithRegisters(const SyscallPreservedRegisters* registers);
 
 void InitSyscalls();
 void SyscallHandler();
 void DispatchSyscall(u64 syscallNumber);
 
-extern VirtAddr g_syscallFunctions[3];
+extern VirtAddr g_syscallFunctions[SYSCALL_COUNT];
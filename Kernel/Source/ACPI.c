@@ -48,6 +48,20 @@ u8 MADTGetAPICEntry(const MADT* madt, MADTBaseEntry** pointer)
 	return 1;
 }
 
+u8 SRATGetEntry(const SRAT* srat, SRATBaseEntry** pointer)
+{
+	u8* offset = (u8*)*pointer;
+
+	if (offset + (*pointer)->Length >= (u8*)(srat) + srat->Header.Length) {
+		return 0;
+	}
+
+	offset += (*pointer)->Length;
+	*pointer = (SRATBaseEntry*)offset;
+
+	return 1;
+}
+
 Result InitXSDT()
 {
 	XSDT* xsdt = PhysAddrAsPointer(g_bootInfo.XSDTPhysAddr);
@@ -35,11 +35,13 @@ Result CPUIDSaveInfo(CPUInfo* cpuInfo)
 	if (!result) {
 		cpuInfo->SupportsAVX = (featuresInfo.ECX & (1U << 28)) != 0;
 		cpuInfo->SupportsX2APIC = (featuresInfo.ECX & (1U << 21)) != 0;
+		cpuInfo->SupportsPCID = (featuresInfo.ECX & (1U << 17)) != 0;
 		cpuInfo->SupportsRDRAND = (featuresInfo.ECX & (1U << 30)) != 0;
 		cpuInfo->SupportsMMX = (featuresInfo.EDX & (1U << 23)) != 0;
 		cpuInfo->SupportsSSE = (featuresInfo.EDX & (1U << 25)) != 0;
 		cpuInfo->SupportsSSE2 = (featuresInfo.EDX & (1U << 26)) != 0;
 		cpuInfo->SupportsXAPIC = (featuresInfo.EDX & (1U << 9)) != 0;
+		cpuInfo->SupportsPGE = (featuresInfo.EDX & (1U << 13)) != 0;
 	}
 
 	result = CPUID(cpuInfo, 0x80000008, 0, &featuresInfo);
@@ -51,6 +53,7 @@ Result CPUIDSaveInfo(CPUInfo* cpuInfo)
 	result = CPUID(cpuInfo, 7, 0, &featuresInfo);
 	if (!result) {
 		cpuInfo->SupportsRDSEED = (featuresInfo.EBX & (1U << 18)) != 0;
+		cpuInfo->SupportsINVPCID = (featuresInfo.EBX & (1U << 10)) != 0;
 	}
 
 	return ResultOk;
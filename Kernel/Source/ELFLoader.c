@@ -2,6 +2,8 @@
 
 #include "Logger.h"
 #include "Memory.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/Heap.h"
 #include "Memory/VirtualMemoryAllocator.h"
 #include "Storage/VirtualFileSystem.h"
 #include "elf.h"
@@ -53,19 +55,19 @@ static Result ELFReadProgHeaderTable(Elf64_Ehdr* elfHeader, usz elfFile, Elf64_P
 	}
 
 	usz progHeaderTableSize = elfHeader->e_phnum * sizeof(Elf64_Phdr);
-	void* progHeaderTablePage;
-	result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, Page4KiBNext(progHeaderTableSize), PageWriteable, &progHeaderTablePage);
+	void* progHeaderTableMemory;
+	result = HeapAllocate(&g_kernelHeap, progHeaderTableSize, &progHeaderTableMemory);
 	if (result) {
 		return result;
 	}
 
-	result = FileRead(elfFile, progHeaderTableSize, progHeaderTablePage);
+	result = FileRead(elfFile, progHeaderTableSize, progHeaderTableMemory);
 	if (result) {
-		DeallocateBackedVirtualMemory(&g_kernelMemoryAllocator, progHeaderTablePage, Page4KiBNext(progHeaderTableSize));
+		HeapDeallocate(&g_kernelHeap, progHeaderTableMemory, progHeaderTableSize);
 		return result;
 	}
 
-	*progHeaderTable = progHeaderTablePage;
+	*progHeaderTable = progHeaderTableMemory;
 
 	return result;
 }
@@ -138,10 +140,9 @@ static Result ELFCopySegments(Process* process, usz elfFile, Elf64_Phdr* progHea
 		if (progHeaders[i].p_type != PT_LOAD)
 			continue;
 
+		// The segments are backed by zeroed frames, so only the file contents have to be copied
 		void* segment = (u8*)progHeaders[i].p_vaddr + base;
 
-		MemoryFill(segment, 0, progHeaders[i].p_memsz);
-
 		result = FileSetOffset(elfFile, progHeaders[i].p_offset);
 		if (result) {
 			return result;
@@ -205,8 +206,15 @@ static Result ELFRemapSegments(Process* process)
 
 	ELFSegmentRegion* segmentRegionIter = nullptr;
 	while (!SizedBlockIterate(&process->ELFSegmentMap, (void**)&segmentRegionIter)) {
-		result = RemapVirtualMemory(&process->VirtualMemoryAllocator, segmentRegionIter->Begin,
-			segmentRegionIter->End - segmentRegionIter->Begin, segmentRegionIter->Flags | PageUserAccessible);
+		const PageTableEntryFlags flags = segmentRegionIter->Flags | PageUserAccessible;
+
+		result = RemapVirtualMemory(
+			&process->VirtualMemoryAllocator, segmentRegionIter->Begin, segmentRegionIter->End - segmentRegionIter->Begin, flags);
+		if (result) {
+			return result;
+		}
+
+		result = MappedRegionAdd(&process->MappedRegions, segmentRegionIter->Begin, segmentRegionIter->End, flags, MappedRegionFile);
 		if (result) {
 			return result;
 		}
@@ -303,6 +311,7 @@ Result ProcessLoadELF(Process* process, const i8* elfPath)
 		goto CloseFile;
 	}
 
+	const FrameTag previousTag = FrameAllocatorSetTag(&g_frameAllocator, FrameTagELF);
 	ProcessStepInto(process);
 	if (elfHeader.e_type == ET_EXEC) {
 		result = ELFLoadEXEC(process, fileDescriptor, &elfHeader, progHeaders, elfHeader.e_phnum);
@@ -312,8 +321,9 @@ Result ProcessLoadELF(Process* process, const i8* elfPath)
 		result = ResultSerialOutputUnavailable;
 	}
 	ProcessStepOut();
+	FrameAllocatorSetTag(&g_frameAllocator, previousTag);
 
-	DeallocateBackedVirtualMemory(&g_kernelMemoryAllocator, progHeaders, Page4KiBNext(sizeof(Elf64_Phdr) * elfHeader.e_phnum));
+	HeapDeallocate(&g_kernelHeap, progHeaders, sizeof(Elf64_Phdr) * elfHeader.e_phnum);
 CloseFile:
 	FileClose(&g_virtualFileSystem, fileDescriptor);
 
@@ -4,7 +4,10 @@
 #include "Instructions.h"
 #include "Keyboard.h"
 #include "Logger.h"
+#include "Memory/MappedRegionTree.h"
+#include "Memory/Page.h"
 #include "Memory/PageTable.h"
+#include "Memory/TLB.h"
 #include "Panic.h"
 #include "Random.h"
 #include "Scheduler.h"
@@ -84,19 +87,63 @@ typedef enum PageFaultCause : u16 {
 	PageFaultCauseSoftwareGuardExtensions = 1 << 15,
 } PageFaultCause;
 
-__attribute__((interrupt)) void PageFaultInterruptHandler(InterruptFrame* frame, u64 errorCode)
+/// Checks whether the faulting access lies in one of the current process's mapped regions and is allowed by its flags.
+/// Faults in the kernel half, or ones that happen while the kernel itself runs, aren't described by any regions and always pass.
+static bool PageFaultInMappedRegion(VirtAddr faultVirtAddr, u64 errorCode, const MappedRegion** region)
 {
-	PrintCommonExceptionInfo(frame, "Page Fault");
+	const Process* process = g_scheduler.CurrentThread->ParentProcess;
+	*region = nullptr;
+
+	if (process->ID == 0 || faultVirtAddr >= KERNEL_HALF_BEGIN) {
+		return true;
+	}
+
+	*region = MappedRegionFind(&process->MappedRegions, faultVirtAddr);
+	if (!*region) {
+		return false;
+	}
+
+	return !(errorCode & PageFaultCauseWrite) || ((*region)->Flags & PageWriteable);
+}
 
+__attribute__((interrupt)) void PageFaultInterruptHandler(InterruptFrame* frame, u64 errorCode)
+{
 	u64 faultVirtAddr = 0;
 	__asm__ volatile("mov %%cr2, %0" : "=r"(faultVirtAddr));
 
 	u64 pml4Address = U64_MAX;
 	__asm__ volatile("movq %%cr3, %0" : "=r"(pml4Address));
 
+	PageTableEntry* pml4 = PhysAddrAsPointer(pml4Address & FRAME_ADDRESS_MASK);
+	const Page4KiB faultPage = Page4KiBContaining(faultVirtAddr);
+
+	// Accesses outside of the process's regions or against their flags are never resolved, whatever the page tables say
+	const MappedRegion* region;
+	const bool allowed = PageFaultInMappedRegion(faultVirtAddr, errorCode, &region);
+
+	// The first access to a reserved page just needs a frame, the faulting instruction then gets retried
+	if (allowed && !(errorCode & PageFaultCausePresent) && !PageBackReserved(pml4, faultPage)) {
+		return;
+	}
+
+	// The first write to a shared page makes a copy of it, the stale read-only entry has to be flushed
+	if (allowed && (errorCode & PageFaultCausePresent) && (errorCode & PageFaultCauseWrite) && !PageCopyShared(pml4, faultPage)) {
+		FlushPage(pml4Address & FLAGS_MASK, faultPage);
+		return;
+	}
+
+	PrintCommonExceptionInfo(frame, "Page Fault");
+
 	LogLine(SK_LOG_ERROR "Memory info:");
 	LogLine(SK_LOG_ERROR "Faulty virtual address: 0x%x", faultVirtAddr);
 	LogLine(SK_LOG_ERROR "PML4 address          : 0x%x", pml4Address);
+	if (region) {
+		LogLine(SK_LOG_ERROR "Mapped region         : 0x%x - 0x%x", region->Node.Begin, region->Node.End);
+		LogLine(SK_LOG_ERROR "Mapped region flags   : 0x%x", region->Flags);
+		LogLine(SK_LOG_ERROR "Mapped region backing : %u", region->Backing);
+	} else if (!allowed) {
+		LogLine(SK_LOG_ERROR "Mapped region         : none");
+	}
 	LogLine(SK_LOG_ERROR "");
 
 	LogLine(SK_LOG_ERROR "Error code: %u", errorCode);
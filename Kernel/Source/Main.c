@@ -6,8 +6,12 @@
 #include "GDT.h"
 #include "IDT.h"
 #include "Logger.h"
-#include "Memory/BitmapFrameAllocator.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/Heap.h"
+#include "Memory/SharedMemory.h"
+#include "Memory/TLB.h"
 #include "Memory/VirtualMemoryAllocator.h"
+#include "NUMA.h"
 #include "PCI.h"
 #include "Panic.h"
 #include "Parameters.h"
@@ -50,6 +54,9 @@ void KernelMain(BootInfo* bootInfo)
 	LogLine(SK_LOG_INFO "Saving the CPUID processor information");
 	SK_PANIC_ON_ERROR(CPUIDSaveInfo(&g_cpuInformation), "Could not read the CPUID information");
 
+	LogLine(SK_LOG_INFO "Initializing the TLB management");
+	InitTLB();
+
 	DisableInterrupts();
 
 	// Doing that here, to not run into issues with unmasked interrupts or other bullshit later
@@ -62,26 +69,49 @@ void KernelMain(BootInfo* bootInfo)
 
 	EnableInterrupts();
 
-	LogLine(SK_LOG_INFO "Initializing the bitmap frame allocator");
-	SK_PANIC_ON_ERROR(BitmapFrameAllocatorInit(&g_frameAllocator, (MemoryMapEntry*)g_bootInfo.MemoryMap, g_bootInfo.MemoryMapEntries),
+	// The NUMA topology decides how the frame allocator splits physical memory up, so the ACPI tables come first
+	LogLine(SK_LOG_INFO "Parsing the ACPI structures");
+	SK_PANIC_ON_ERROR(InitXSDT(), "An unexpected error occured while trying to parse ACPI structures");
+
+	LogLine(SK_LOG_INFO "Detecting the NUMA topology");
+	SK_PANIC_ON_ERROR(InitNUMA(), "An unexpected error occured while trying to detect the NUMA topology");
+
+	FrameAllocatorEngine frameAllocatorEngine = FrameAllocatorBitmap;
+	if (g_parameters.BuddyAllocator) {
+		LogLine(SK_LOG_INFO "Initializing the buddy frame allocator");
+		frameAllocatorEngine = FrameAllocatorBuddy;
+	} else {
+		LogLine(SK_LOG_INFO "Initializing the bitmap frame allocator");
+	}
+
+	SK_PANIC_ON_ERROR(FrameAllocatorInit(
+						  &g_frameAllocator, frameAllocatorEngine, (MemoryMapEntry*)g_bootInfo.MemoryMap, g_bootInfo.MemoryMapEntries),
 		"Could not initialize the frame allocator");
 
 	LogLine(SK_LOG_DEBUG "Mapped Physical memory offset: 0x%x", g_bootInfo.PhysicalMemoryOffset);
 
 	LogLine(SK_LOG_INFO "Initializing the virtual memory allocator");
-	SK_PANIC_ON_ERROR(InitKernelVirtualMemory(2, 0xffffff0000000000, 102400),
+	SK_PANIC_ON_ERROR(InitKernelVirtualMemory(2),
 		"An unexpected error occured while trying to initialize the virtual memory allocator");
 
-	LogLine(SK_LOG_INFO "Parsing the ACPI structures");
-	SK_PANIC_ON_ERROR(InitXSDT(), "An unexpected error occured while trying to parse ACPI structures");
+	LogLine(SK_LOG_INFO "Initializing the kernel heap");
+	SK_PANIC_ON_ERROR(InitKernelHeap(&g_kernelHeap), "An unexpected error occured while trying to initialize the kernel heap");
 
 	LogLine(SK_LOG_INFO "Initializing the scheduler");
 	InitSyscalls();
+	FrameAllocatorSetTag(&g_frameAllocator, FrameTagScheduler);
 	SK_PANIC_ON_ERROR(InitScheduler(), "An unexpected error occured while trying to initialize the scheduler");
+	FrameAllocatorSetTag(&g_frameAllocator, FrameTagUntagged);
+
+	LogLine(SK_LOG_INFO "Initializing the shared memory objects");
+	SK_PANIC_ON_ERROR(
+		InitSharedMemory(&g_sharedMemory), "An unexpected error occured while trying to initialize the shared memory objects");
 
 	LogLine(SK_LOG_INFO "Initializing the x2APIC");
 	SK_PANIC_ON_ERROR(InitAPIC(), "An unexpected error occured while trying to initialize the APIC");
 
+	FrameAllocatorSetTag(&g_frameAllocator, FrameTagFileSystem);
+
 	LogLine(SK_LOG_INFO "Initializing the virtual file system layer");
 	SK_PANIC_ON_ERROR(InitVirtualFileSystem(&g_virtualFileSystem),
 		"An unexpected error occured while trying to initialize the virtual file system layer");
@@ -89,6 +119,8 @@ void KernelMain(BootInfo* bootInfo)
 	LogLine(SK_LOG_INFO "Initializing the STFS ramdisk builtin driver");
 	SK_PANIC_ON_ERROR(InitSTFS(), "An unexpected error occured while trying to initialize the STFS ramdisk builtin driver");
 
+	FrameAllocatorSetTag(&g_frameAllocator, FrameTagUntagged);
+
 	LogLine(SK_LOG_INFO "Scanning for available PCI devices");
 	SK_PANIC_ON_ERROR(ScanPCIDevices(), "An unexpected error occured while trying to scan for available PCI devices");
 
@@ -96,7 +128,9 @@ void KernelMain(BootInfo* bootInfo)
 
 	SK_PANIC_ON_ERROR(DetectGPTPartitions(), "An unexpected error occured while trying to detect GPT partitions");
 
+	FrameAllocatorSetTag(&g_frameAllocator, FrameTagFileSystem);
 	SK_PANIC_ON_ERROR(InitExt2(), "An unexpected error occured while trying to initialize the Ext2 driver");
+	FrameAllocatorSetTag(&g_frameAllocator, FrameTagUntagged);
 
 	Process* process;
 	SK_PANIC_ON_ERROR(ProcessCreate(&process), "xd!");
@@ -110,7 +144,14 @@ void KernelMain(BootInfo* bootInfo)
 	ThreadLaunch(process->MainThread);
 
 	VirtualMemoryPrintRegions(&g_kernelMemoryAllocator);
-
-	while (true)
-		__asm__ volatile("hlt");
+	FrameAllocatorPrintStatistics(&g_frameAllocator);
+	HeapPrintStatistics(&g_kernelHeap);
+
+	// Whenever the scheduler gets back here there is nothing else to do, so finish freeing the memory left out during boot
+	// and prepare zeroed frames, only halting once both are done
+	while (true) {
+		if (!FreeDeferredFrames(&g_frameAllocator) && !RefillZeroedFrame(&g_frameAllocator)) {
+			__asm__ volatile("hlt");
+		}
+	}
 }
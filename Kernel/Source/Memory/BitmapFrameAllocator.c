@@ -3,9 +3,8 @@
 #include "Logger.h"
 #include "Memory.h"
 #include "Memory/Frame.h"
-#include "Panic.h"
-
-BitmapFrameAllocator g_frameAllocator = {};
+#include "Memory/FrameInfo.h"
+#include "NUMA.h"
 
 static void SetFrameStatus(BitmapFrameAllocator* frameAllocator, Frame4KiB frame, bool used)
 {
@@ -15,11 +14,123 @@ static void SetFrameStatus(BitmapFrameAllocator* frameAllocator, Frame4KiB frame
 
 	const u64 mask = 1ULL << bitIndex;
 
+	// Already in the requested state, nothing to update
+	if (((frameAllocator->FrameBitmap[mapIndex] & mask) != 0) == used) {
+		return;
+	}
+
 	if (used) {
+		frameAllocator->FreeFrames[FrameZoneContaining(frame)]--;
 		frameAllocator->FrameBitmap[mapIndex] |= mask;
+
+		// The summaries only have to change when the word has just become full
+		if (frameAllocator->FrameBitmap[mapIndex] != U64_MAX) {
+			return;
+		}
+
+		frameAllocator->WordSummary[mapIndex / 64] &= ~(1ULL << (mapIndex % 64));
+		if (!frameAllocator->WordSummary[mapIndex / 64]) {
+			frameAllocator->GroupSummary[mapIndex / BITMAP_GROUP_WORDS] &= ~(1ULL << ((mapIndex / 64) % 64));
+		}
 	} else {
+		frameAllocator->FreeFrames[FrameZoneContaining(frame)]++;
 		frameAllocator->FrameBitmap[mapIndex] &= ~mask;
+
+		frameAllocator->WordSummary[mapIndex / 64] |= 1ULL << (mapIndex % 64);
+		frameAllocator->GroupSummary[mapIndex / BITMAP_GROUP_WORDS] |= 1ULL << ((mapIndex / 64) % 64);
+	}
+}
+
+/// Sets the status of a whole range of frames, touching every bitmap word just once instead of once per frame.
+static void SetFrameRangeStatus(BitmapFrameAllocator* frameAllocator, Frame4KiB frame, usz count, bool used)
+{
+	if (count == 0) {
+		return;
+	}
+
+	const usz firstIndex = frame / FRAME_4KIB_SIZE_BYTES;
+	const usz lastIndex = firstIndex + count - 1;
+	const usz firstMapIndex = firstIndex / 64;
+	const usz lastMapIndex = lastIndex / 64;
+
+	for (usz mapIndex = firstMapIndex; mapIndex <= lastMapIndex; mapIndex++) {
+		u64 mask = U64_MAX;
+		if (mapIndex == firstMapIndex) {
+			mask &= U64_MAX << (firstIndex % 64);
+		}
+		if (mapIndex == lastMapIndex) {
+			mask &= U64_MAX >> (63 - (lastIndex % 64));
+		}
+
+		// Zone boundaries are far more aligned than a single bitmap word, so all of its frames belong to the same zone
+		const FrameZone zone = FrameZoneContaining(mapIndex * 64 * FRAME_4KIB_SIZE_BYTES);
+
+		if (used) {
+			frameAllocator->FreeFrames[zone] -= __builtin_popcountll(~frameAllocator->FrameBitmap[mapIndex] & mask);
+			frameAllocator->FrameBitmap[mapIndex] |= mask;
+
+			if (frameAllocator->FrameBitmap[mapIndex] != U64_MAX) {
+				continue;
+			}
+
+			frameAllocator->WordSummary[mapIndex / 64] &= ~(1ULL << (mapIndex % 64));
+			if (!frameAllocator->WordSummary[mapIndex / 64]) {
+				frameAllocator->GroupSummary[mapIndex / BITMAP_GROUP_WORDS] &= ~(1ULL << ((mapIndex / 64) % 64));
+			}
+		} else {
+			frameAllocator->FreeFrames[zone] += __builtin_popcountll(frameAllocator->FrameBitmap[mapIndex] & mask);
+			frameAllocator->FrameBitmap[mapIndex] &= ~mask;
+
+			frameAllocator->WordSummary[mapIndex / 64] |= 1ULL << (mapIndex % 64);
+			frameAllocator->GroupSummary[mapIndex / BITMAP_GROUP_WORDS] |= 1ULL << ((mapIndex / 64) % 64);
+		}
+	}
+}
+
+/// Marks up to the given number of frames from the memory map as unused, continuing where the previous call left off.
+/// Returns the number of frames actually freed, zero once the whole memory map has been processed.
+static usz FreeMemoryMapFrames(BitmapFrameAllocator* frameAllocator, usz maxFrames)
+{
+	usz freedFrames = 0;
+
+	// I assume the last entry is a "NULL-descriptor" so I just skip it
+	while (freedFrames < maxFrames && frameAllocator->DeferredEntry < frameAllocator->MemoryMapEntries - 2) {
+		const MemoryMapEntry* entry = &frameAllocator->MemoryMap[frameAllocator->DeferredEntry];
+		Frame4KiB regionEnd = Frame4KiBContaining(entry->PhysicalEnd);
+
+		// Entries above the physical memory mapping are never made available
+		if (Frame4KiBContaining(entry->PhysicalStart) > frameAllocator->LastFrame) {
+			frameAllocator->DeferredEntry++;
+			frameAllocator->DeferredFrame = 0;
+			continue;
+		}
+
+		if (regionEnd > frameAllocator->LastFrame) {
+			regionEnd = frameAllocator->LastFrame;
+		}
+
+		if (frameAllocator->DeferredFrame < Frame4KiBContaining(entry->PhysicalStart)) {
+			frameAllocator->DeferredFrame = Frame4KiBContaining(entry->PhysicalStart);
+		}
+
+		usz count = ((regionEnd - frameAllocator->DeferredFrame) / FRAME_4KIB_SIZE_BYTES) + 1;
+		if (count > maxFrames - freedFrames) {
+			count = maxFrames - freedFrames;
+		}
+
+		FrameInfoClear(frameAllocator->DeferredFrame, count);
+		SetFrameRangeStatus(frameAllocator, frameAllocator->DeferredFrame, count, false);
+		freedFrames += count;
+		frameAllocator->DeferredFrames -= count;
+		frameAllocator->DeferredFrame += count * FRAME_4KIB_SIZE_BYTES;
+
+		if (frameAllocator->DeferredFrame > regionEnd) {
+			frameAllocator->DeferredEntry++;
+			frameAllocator->DeferredFrame = 0;
+		}
 	}
+
+	return freedFrames;
 }
 
 static bool GetFrameStatus(BitmapFrameAllocator* frameAllocator, Frame4KiB frame)
@@ -36,18 +147,36 @@ static bool GetFrameStatus(BitmapFrameAllocator* frameAllocator, Frame4KiB frame
 Result BitmapFrameAllocatorInit(BitmapFrameAllocator* frameAllocator, MemoryMapEntry* memoryMap, usz memoryMapEntries)
 {
 	// I assume the last entry is a "NULL-descriptor" so I just skip it
-	const Frame4KiB lastFrame = Frame4KiBContaining(memoryMap[memoryMapEntries - 2].PhysicalEnd);
+	Frame4KiB lastFrame = Frame4KiBContaining(memoryMap[memoryMapEntries - 2].PhysicalEnd);
+
+	// Allocated frames get zeroed or used as page tables through the physical memory mapping, so only the frames it reaches are managed
+	const Frame4KiB lastMappedFrame = Frame4KiBContaining(g_bootInfo.PhysicalMemoryMappingSize - 1);
+	if (lastFrame > lastMappedFrame) {
+		lastFrame = lastMappedFrame;
+	}
 
-	// The number of needed frames to allocate the frame bitmap is calculated with the followinf formula:
-	// number of the last frame / 8 rounded up / frame size rounded up (4096)
-	const usz neededFrames = ((((lastFrame / FRAME_4KIB_SIZE_BYTES) + 7) / 8) + FRAME_4KIB_SIZE_BYTES - 1) / FRAME_4KIB_SIZE_BYTES;
+	// The frame metadata array comes first, so it stays cache line aligned, then the bitmap needs a bit per frame,
+	// the word summary a bit per bitmap word and the group summary a bit per word summary word,
+	// all of them are placed one after another and rounded up to the frame size (4096)
+	const usz frameInfoBytes = FrameInfoBytes(lastFrame);
+	const usz bitmapWords = ((lastFrame / FRAME_4KIB_SIZE_BYTES) / 64) + 1;
+	const usz wordSummaryWords = (bitmapWords + 63) / 64;
+	const usz groupSummaryWords = (wordSummaryWords + 63) / 64;
+	const usz neededBytes = frameInfoBytes + ((bitmapWords + wordSummaryWords + groupSummaryWords) * sizeof(u64));
+	const usz neededFrames = (neededBytes + FRAME_4KIB_SIZE_BYTES - 1) / FRAME_4KIB_SIZE_BYTES;
 
 	if (neededFrames >= ((memoryMap[0].PhysicalEnd + 1 - memoryMap[0].PhysicalStart) / FRAME_4KIB_SIZE_BYTES)) {
-		LogLine(SK_LOG_ERROR "There is not enough contiguous physical frames to allocate the frame bitmap");
+		LogLine(SK_LOG_ERROR "There is not enough contiguous physical frames to allocate the frame bitmap and metadata");
 		return ResultNotEnoughMemoryFrames;
 	}
 
-	frameAllocator->FrameBitmap = PhysAddrAsPointer(memoryMap[0].PhysicalStart);
+	FrameInfoInit(PhysAddrAsPointer(memoryMap[0].PhysicalStart), lastFrame);
+
+	frameAllocator->FrameBitmap = PhysAddrAsPointer(memoryMap[0].PhysicalStart + frameInfoBytes);
+	frameAllocator->WordSummary = frameAllocator->FrameBitmap + bitmapWords;
+	frameAllocator->GroupSummary = frameAllocator->WordSummary + wordSummaryWords;
+	frameAllocator->BitmapWords = bitmapWords;
+	frameAllocator->GroupSummaryWords = groupSummaryWords;
 	frameAllocator->MemoryMap = memoryMap;
 	frameAllocator->MemoryMapEntries = memoryMapEntries;
 	frameAllocator->LastAllocated = 0;
@@ -56,27 +185,48 @@ Result BitmapFrameAllocatorInit(BitmapFrameAllocator* frameAllocator, MemoryMapE
 	memoryMap[0].PhysicalStart += neededFrames * FRAME_4KIB_SIZE_BYTES;
 	frameAllocator->LastFrame = lastFrame;
 
-	// We set every frame as used
-	MemoryFill(frameAllocator->FrameBitmap, 255, neededFrames * FRAME_4KIB_SIZE_BYTES);
+	// We set every frame as used, so none of the bitmap words have any unallocated frames
+	MemoryFill(frameAllocator->FrameBitmap, 255, bitmapWords * sizeof(u64));
+	MemoryFill(frameAllocator->WordSummary, 0, (wordSummaryWords + groupSummaryWords) * sizeof(u64));
 
-	// Then we mark frames in the memory map as unused since the map only contains available memory regions
-	for (usz i = 0; i < memoryMapEntries - 2; i++) {
-		const Frame4KiB regionEnd = Frame4KiBContaining(frameAllocator->MemoryMap[i].PhysicalEnd);
-		Frame4KiB frame = Frame4KiBContaining(frameAllocator->MemoryMap[i].PhysicalStart);
+	// Then we mark frames in the memory map as unused since the map only contains available memory regions,
+	// but only enough of them to boot, the rest is left for `BitmapFreeDeferredFrames` so boot time doesn't depend on the amount of RAM
+	frameAllocator->DeferredEntry = 0;
+	frameAllocator->DeferredFrame = 0;
+	frameAllocator->DeferredFrames = 0;
+
+	for (usz zone = 0; zone < FRAME_ZONE_COUNT; zone++) {
+		frameAllocator->TotalFrames[zone] = 0;
+		frameAllocator->FreeFrames[zone] = 0;
+
+		for (usz i = 0; i < memoryMapEntries - 2; i++) {
+			const Frame4KiB regionStart = Frame4KiBContaining(memoryMap[i].PhysicalStart);
+			Frame4KiB regionEnd = Frame4KiBContaining(memoryMap[i].PhysicalEnd);
+
+			if (regionStart > lastFrame) {
+				continue;
+			}
 
-		while (frame <= regionEnd) {
-			SetFrameStatus(frameAllocator, frame, false);
-			frame += FRAME_4KIB_SIZE_BYTES;
+			if (regionEnd > lastFrame) {
+				regionEnd = lastFrame;
+			}
+
+			frameAllocator->TotalFrames[zone] += FrameZoneFramesInRange(zone, regionStart, regionEnd);
 		}
+
+		frameAllocator->DeferredFrames += frameAllocator->TotalFrames[zone];
 	}
 
+	FreeMemoryMapFrames(frameAllocator, BITMAP_BOOT_FRAMES);
+
 	return ResultOk;
 }
 
-Result AllocateContiguousFrames(BitmapFrameAllocator* frameAllocator, usz count, Frame4KiB* frame)
+/// Looks for a free range of frames beginning anywhere between the two given frames (inclusive) and marks it as used.
+static Result AllocateContiguousFramesBetween(
+	BitmapFrameAllocator* frameAllocator, Frame4KiB firstFrame, Frame4KiB lastStartFrame, usz count, Frame4KiB* frame)
 {
-	for (Frame4KiB checkedFrame = frameAllocator->LastAllocated + FRAME_4KIB_SIZE_BYTES; checkedFrame <= frameAllocator->LastFrame;
-		checkedFrame += FRAME_4KIB_SIZE_BYTES) {
+	for (Frame4KiB checkedFrame = firstFrame; checkedFrame <= lastStartFrame; checkedFrame += FRAME_4KIB_SIZE_BYTES) {
 		if (GetFrameStatus(frameAllocator, checkedFrame)) {
 			continue;
 		}
@@ -94,9 +244,7 @@ Result AllocateContiguousFrames(BitmapFrameAllocator* frameAllocator, usz count,
 			continue;
 		}
 
-		for (usz i = 0; i < count; i++) {
-			SetFrameStatus(frameAllocator, checkedFrame + (i * FRAME_4KIB_SIZE_BYTES), true);
-		}
+		SetFrameRangeStatus(frameAllocator, checkedFrame, count, true);
 
 		*frame = checkedFrame;
 		frameAllocator->LastAllocated = checkedFrame + (count - 1) * FRAME_4KIB_SIZE_BYTES;
@@ -106,26 +254,160 @@ Result AllocateContiguousFrames(BitmapFrameAllocator* frameAllocator, usz count,
 	return ResultOutOfMemory;
 }
 
-Frame4KiB AllocateFrame(BitmapFrameAllocator* frameAllocator)
+/// Allocates a contiguous range of frames lying entirely between the two given frames (inclusive).
+static Result AllocateContiguousFramesInRange(
+	BitmapFrameAllocator* frameAllocator, Frame4KiB firstFrame, Frame4KiB lastFrame, usz count, Frame4KiB* frame)
 {
-	for (Frame4KiB checkedFrame = frameAllocator->LastAllocated + FRAME_4KIB_SIZE_BYTES; checkedFrame <= frameAllocator->LastFrame;
-		checkedFrame += FRAME_4KIB_SIZE_BYTES) {
-		if (GetFrameStatus(frameAllocator, checkedFrame)) {
+	// The whole range has to fit
+	if ((count - 1) * FRAME_4KIB_SIZE_BYTES > lastFrame - firstFrame) {
+		return ResultOutOfMemory;
+	}
+
+	const Frame4KiB lastStartFrame = lastFrame - (count - 1) * FRAME_4KIB_SIZE_BYTES;
+
+	// The search begins after the last allocation, but if that's outside of the range it just starts at the range's beginning
+	Frame4KiB startFrame = frameAllocator->LastAllocated + FRAME_4KIB_SIZE_BYTES;
+	if (startFrame < firstFrame || startFrame > lastStartFrame) {
+		startFrame = firstFrame;
+	}
+
+	Result result = AllocateContiguousFramesBetween(frameAllocator, startFrame, lastStartFrame, count, frame);
+	if (!result || startFrame == firstFrame) {
+		return result;
+	}
+
+	// Nothing was found after the last allocation, but there might still be a fitting range before it
+	return AllocateContiguousFramesBetween(frameAllocator, firstFrame, startFrame - FRAME_4KIB_SIZE_BYTES, count, frame);
+}
+
+/// Allocates a single frame between the two given frames (inclusive).
+/// Every set summary bit guarantees a free frame in the level below it, so apart from the range's edges,
+/// which have to be masked off, a free frame is found with just a bit scan on each level.
+static Result AllocateFrameInRange(BitmapFrameAllocator* frameAllocator, Frame4KiB firstFrame, Frame4KiB lastFrame, Frame4KiB* frame)
+{
+	const usz firstIndex = firstFrame / FRAME_4KIB_SIZE_BYTES;
+	const usz lastIndex = lastFrame / FRAME_4KIB_SIZE_BYTES;
+	const usz firstMapIndex = firstIndex / 64;
+	const usz lastMapIndex = lastIndex / 64;
+	const usz firstSummaryIndex = firstMapIndex / 64;
+	const usz lastSummaryIndex = lastMapIndex / 64;
+	const usz firstGroupIndex = firstMapIndex / BITMAP_GROUP_WORDS;
+	const usz lastGroupIndex = lastMapIndex / BITMAP_GROUP_WORDS;
+
+	for (usz groupIndex = firstGroupIndex; groupIndex <= lastGroupIndex; groupIndex++) {
+		u64 groupBits = frameAllocator->GroupSummary[groupIndex];
+		if (groupIndex == firstGroupIndex) {
+			groupBits &= U64_MAX << (firstSummaryIndex % 64);
+		}
+		if (groupIndex == lastGroupIndex) {
+			groupBits &= U64_MAX >> (63 - (lastSummaryIndex % 64));
+		}
+
+		while (groupBits) {
+			const usz summaryIndex = (groupIndex * 64) + __builtin_ctzll(groupBits);
+			groupBits &= groupBits - 1;
+
+			u64 summaryBits = frameAllocator->WordSummary[summaryIndex];
+			if (summaryIndex == firstSummaryIndex) {
+				summaryBits &= U64_MAX << (firstMapIndex % 64);
+			}
+			if (summaryIndex == lastSummaryIndex) {
+				summaryBits &= U64_MAX >> (63 - (lastMapIndex % 64));
+			}
+
+			while (summaryBits) {
+				const usz mapIndex = (summaryIndex * 64) + __builtin_ctzll(summaryBits);
+				summaryBits &= summaryBits - 1;
+
+				u64 freeBits = ~frameAllocator->FrameBitmap[mapIndex];
+				if (mapIndex == firstMapIndex) {
+					freeBits &= U64_MAX << (firstIndex % 64);
+				}
+				if (mapIndex == lastMapIndex) {
+					freeBits &= U64_MAX >> (63 - (lastIndex % 64));
+				}
+
+				if (!freeBits) {
+					continue;
+				}
+
+				*frame = ((mapIndex * 64) + __builtin_ctzll(freeBits)) * FRAME_4KIB_SIZE_BYTES;
+
+				SetFrameStatus(frameAllocator, *frame, true);
+				frameAllocator->LastAllocated = *frame;
+
+				return ResultOk;
+			}
+		}
+	}
+
+	return ResultOutOfMemory;
+}
+
+/// Clamps the given node's memory range to the zone and the managed memory, returns false if nothing is left.
+static bool ClampRange(const BitmapFrameAllocator* frameAllocator, const NUMAMemoryRange* range, FrameZone zone, Frame4KiB* firstFrame,
+	Frame4KiB* lastFrame)
+{
+	*firstFrame = Frame4KiBNext(range->Begin);
+	*lastFrame = Frame4KiBContaining(range->End - 1);
+
+	if (*firstFrame < FrameZoneFirstFrame(zone)) {
+		*firstFrame = FrameZoneFirstFrame(zone);
+	}
+
+	if (*lastFrame > FrameZoneLastFrame(zone)) {
+		*lastFrame = FrameZoneLastFrame(zone);
+	}
+
+	if (*lastFrame > frameAllocator->LastFrame) {
+		*lastFrame = frameAllocator->LastFrame;
+	}
+
+	return *firstFrame <= *lastFrame;
+}
+
+Result BitmapAllocateContiguousFrames(BitmapFrameAllocator* frameAllocator, u8 node, FrameZone zone, usz count, Frame4KiB* frame)
+{
+	if (count == 0) {
+		return ResultOutOfRange;
+	}
+
+	for (usz i = 0; i < g_numa.MemoryRangeCount; i++) {
+		Frame4KiB firstFrame;
+		Frame4KiB lastFrame;
+		if (g_numa.MemoryRanges[i].Node != node || !ClampRange(frameAllocator, &g_numa.MemoryRanges[i], zone, &firstFrame, &lastFrame)) {
 			continue;
 		}
 
-		SetFrameStatus(frameAllocator, checkedFrame, true);
-		frameAllocator->LastAllocated = checkedFrame;
+		if (!AllocateContiguousFramesInRange(frameAllocator, firstFrame, lastFrame, count, frame)) {
+			return ResultOk;
+		}
+	}
+
+	return ResultOutOfMemory;
+}
+
+Result BitmapAllocateFrame(BitmapFrameAllocator* frameAllocator, u8 node, FrameZone zone, Frame4KiB* frame)
+{
+	for (usz i = 0; i < g_numa.MemoryRangeCount; i++) {
+		Frame4KiB firstFrame;
+		Frame4KiB lastFrame;
+		if (g_numa.MemoryRanges[i].Node != node || !ClampRange(frameAllocator, &g_numa.MemoryRanges[i], zone, &firstFrame, &lastFrame)) {
+			continue;
+		}
 
-		return checkedFrame;
+		if (!AllocateFrameInRange(frameAllocator, firstFrame, lastFrame, frame)) {
+			return ResultOk;
+		}
 	}
 
-	SK_PANIC("The kernel ran out of memory");
+	return ResultOutOfMemory;
 }
 
-Result DeallocateContiguousFrames(BitmapFrameAllocator* frameAllocator, Frame4KiB frame, usz count)
+Result BitmapDeallocateContiguousFrames(BitmapFrameAllocator* frameAllocator, Frame4KiB frame, usz count)
 {
-	if (frame + (count * FRAME_4KIB_SIZE_BYTES) > frameAllocator->LastFrame) {
+	// The last frame is inclusive, so a range may end right at it
+	if (frame + (count * FRAME_4KIB_SIZE_BYTES) > frameAllocator->LastFrame + FRAME_4KIB_SIZE_BYTES) {
 		return ResultOutOfRange;
 	}
 
@@ -136,16 +418,14 @@ Result DeallocateContiguousFrames(BitmapFrameAllocator* frameAllocator, Frame4Ki
 		}
 	}
 
-	for (usz i = 0; i < count; i++) {
-		SetFrameStatus(frameAllocator, frame + (i * FRAME_4KIB_SIZE_BYTES), false);
-	}
+	SetFrameRangeStatus(frameAllocator, frame, count, false);
 
 	frameAllocator->LastAllocated = 0;
 
 	return ResultOk;
 }
 
-void DeallocateFrame(BitmapFrameAllocator* frameAllocator, Frame4KiB frame)
+void BitmapDeallocateFrame(BitmapFrameAllocator* frameAllocator, Frame4KiB frame)
 {
 	bool allocated = GetFrameStatus(frameAllocator, frame);
 
@@ -156,3 +436,46 @@ void DeallocateFrame(BitmapFrameAllocator* frameAllocator, Frame4KiB frame)
 	SetFrameStatus(frameAllocator, frame, false);
 	frameAllocator->LastAllocated = 0;
 }
+
+usz BitmapFreeDeferredFrames(BitmapFrameAllocator* frameAllocator, usz maxFrames) { return FreeMemoryMapFrames(frameAllocator, maxFrames); }
+
+void BitmapFreeRunHistogram(const BitmapFrameAllocator* frameAllocator, usz* runs, usz buckets, usz* largestRun)
+{
+	usz run = 0;
+	*largestRun = 0;
+
+	for (usz i = 0; i < buckets; i++) {
+		runs[i] = 0;
+	}
+
+	// One past the last word, so the final run gets counted as well
+	for (usz mapIndex = 0; mapIndex <= frameAllocator->BitmapWords; mapIndex++) {
+		const u64 word = mapIndex < frameAllocator->BitmapWords ? frameAllocator->FrameBitmap[mapIndex] : U64_MAX;
+
+		// Whole free words just extend the current run, without looking at every bit
+		if (word == 0) {
+			run += 64;
+			continue;
+		}
+
+		for (usz bitIndex = 0; bitIndex < 64; bitIndex++) {
+			if (!(word & (1ULL << bitIndex))) {
+				run++;
+				continue;
+			}
+
+			if (run == 0) {
+				continue;
+			}
+
+			const usz bucket = 63 - __builtin_clzll(run);
+			runs[bucket < buckets ? bucket : buckets - 1]++;
+
+			if (run > *largestRun) {
+				*largestRun = run;
+			}
+
+			run = 0;
+		}
+	}
+}
@@ -0,0 +1,392 @@
+#include "Memory/BuddyFrameAllocator.h"
+
+#include "Logger.h"
+#include "Memory.h"
+#include "Memory/Frame.h"
+#include "Memory/FrameInfo.h"
+#include "NUMA.h"
+
+static usz BuddyFrameIndex(Frame4KiB frame) { return frame / FRAME_4KIB_SIZE_BYTES; }
+
+static Frame4KiB BuddyBlockFrame(const BuddyFreeBlock* block) { return (PhysAddr)block - g_bootInfo.PhysicalMemoryOffset; }
+
+static void FreeListPush(BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz order)
+{
+	BuddyFreeBlock** freeList = &frameAllocator->FreeLists[NUMANodeContaining(frame)][FrameZoneContaining(frame)][order];
+	BuddyFreeBlock* block = PhysAddrAsPointer(frame);
+
+	block->Previous = nullptr;
+	block->Next = *freeList;
+	if (block->Next) {
+		block->Next->Previous = block;
+	}
+
+	*freeList = block;
+	frameAllocator->FrameOrders[BuddyFrameIndex(frame)] = BUDDY_FRAME_FREE | order;
+	frameAllocator->FreeBlocks[order]++;
+	frameAllocator->FreeFrames[FrameZoneContaining(frame)] += 1ULL << order;
+}
+
+static void FreeListRemove(BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz order)
+{
+	BuddyFreeBlock* block = PhysAddrAsPointer(frame);
+
+	if (block->Previous) {
+		block->Previous->Next = block->Next;
+	} else {
+		frameAllocator->FreeLists[NUMANodeContaining(frame)][FrameZoneContaining(frame)][order] = block->Next;
+	}
+
+	if (block->Next) {
+		block->Next->Previous = block->Previous;
+	}
+
+	frameAllocator->FrameOrders[BuddyFrameIndex(frame)] = 0;
+	frameAllocator->FreeBlocks[order]--;
+	frameAllocator->FreeFrames[FrameZoneContaining(frame)] -= 1ULL << order;
+}
+
+/// Checks whether any part of the range is free, not just whether one of its frames is the head of a free block.
+/// A free block overlapping the range either begins inside of it or contains its first frame, and a block containing a frame
+/// begins at the frame aligned down to the block's size, so every order is looked at once for the first frame.
+static bool BuddyRangeIsFree(const BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz count)
+{
+	const usz index = BuddyFrameIndex(frame);
+
+	for (usz order = 1; order <= BUDDY_MAX_ORDER; order++) {
+		const usz headIndex = index & ~((1ULL << order) - 1);
+		const u8 headOrder = frameAllocator->FrameOrders[headIndex];
+
+		if ((headOrder & BUDDY_FRAME_FREE) && index < headIndex + (1ULL << (headOrder & ~BUDDY_FRAME_FREE))) {
+			return true;
+		}
+	}
+
+	for (usz i = 0; i < count; i++) {
+		if (frameAllocator->FrameOrders[index + i] & BUDDY_FRAME_FREE) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// Puts the block back onto the free lists, merging it with its buddy for as long as the buddy is free as well.
+static void FreeBlock(BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz order)
+{
+	const usz lastIndex = BuddyFrameIndex(frameAllocator->LastFrame);
+	const NUMAMemoryRange* range = NUMARangeContaining(frame);
+	usz index = BuddyFrameIndex(frame);
+
+	while (order < BUDDY_MAX_ORDER) {
+		const usz buddyIndex = index ^ (1ULL << order);
+		const Frame4KiB buddy = buddyIndex * FRAME_4KIB_SIZE_BYTES;
+
+		if (buddyIndex > lastIndex || frameAllocator->FrameOrders[buddyIndex] != (BUDDY_FRAME_FREE | order)) {
+			break;
+		}
+
+		// NUMA ranges aren't necessarily aligned, so blocks must not be merged across their boundaries
+		if (buddy < range->Begin || buddy >= range->End) {
+			break;
+		}
+
+		FreeListRemove(frameAllocator, buddy, order);
+
+		index &= ~(1ULL << order);
+		order++;
+	}
+
+	FreeListPush(frameAllocator, index * FRAME_4KIB_SIZE_BYTES, order);
+}
+
+/// Splits the range into the largest naturally aligned blocks possible and frees each one of them.
+/// No block ever crosses the end of a NUMA memory range, so every block belongs to a single node.
+static void FreeRange(BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz count)
+{
+	usz index = BuddyFrameIndex(frame);
+
+	while (count > 0) {
+		usz order = index ? (usz)__builtin_ctzll(index) : BUDDY_MAX_ORDER;
+		if (order > BUDDY_MAX_ORDER) {
+			order = BUDDY_MAX_ORDER;
+		}
+
+		const PhysAddr rangeEnd = NUMARangeContaining(index * FRAME_4KIB_SIZE_BYTES)->End;
+		const usz framesInRange = (rangeEnd - (index * FRAME_4KIB_SIZE_BYTES)) / FRAME_4KIB_SIZE_BYTES;
+
+		while ((1ULL << order) > count || ((1ULL << order) > framesInRange)) {
+			order--;
+		}
+
+		FreeBlock(frameAllocator, index * FRAME_4KIB_SIZE_BYTES, order);
+
+		index += 1ULL << order;
+		count -= 1ULL << order;
+	}
+}
+
+/// Frees up to the given number of frames from the memory map, continuing where the previous call left off.
+/// Returns the number of frames actually freed, zero once the whole memory map has been processed.
+/// Blocks freed by separate calls still get merged, as freeing a block always merges it with its free buddies.
+static usz FreeMemoryMapFrames(BuddyFrameAllocator* frameAllocator, usz maxFrames)
+{
+	usz freedFrames = 0;
+
+	// I assume the last entry is a "NULL-descriptor" so I just skip it
+	while (freedFrames < maxFrames && frameAllocator->DeferredEntry < frameAllocator->MemoryMapEntries - 2) {
+		const MemoryMapEntry* entry = &frameAllocator->MemoryMap[frameAllocator->DeferredEntry];
+		Frame4KiB regionEnd = Frame4KiBContaining(entry->PhysicalEnd);
+
+		// Entries above the physical memory mapping are never made available
+		if (Frame4KiBContaining(entry->PhysicalStart) > frameAllocator->LastFrame) {
+			frameAllocator->DeferredEntry++;
+			frameAllocator->DeferredFrame = 0;
+			continue;
+		}
+
+		if (regionEnd > frameAllocator->LastFrame) {
+			regionEnd = frameAllocator->LastFrame;
+		}
+
+		if (frameAllocator->DeferredFrame < Frame4KiBContaining(entry->PhysicalStart)) {
+			frameAllocator->DeferredFrame = Frame4KiBContaining(entry->PhysicalStart);
+		}
+
+		usz count = ((regionEnd - frameAllocator->DeferredFrame) / FRAME_4KIB_SIZE_BYTES) + 1;
+		if (count > maxFrames - freedFrames) {
+			count = maxFrames - freedFrames;
+		}
+
+		FrameInfoClear(frameAllocator->DeferredFrame, count);
+		FreeRange(frameAllocator, frameAllocator->DeferredFrame, count);
+		freedFrames += count;
+		frameAllocator->DeferredFrames -= count;
+		frameAllocator->DeferredFrame += count * FRAME_4KIB_SIZE_BYTES;
+
+		if (frameAllocator->DeferredFrame > regionEnd) {
+			frameAllocator->DeferredEntry++;
+			frameAllocator->DeferredFrame = 0;
+		}
+	}
+
+	return freedFrames;
+}
+
+/// Returns the smallest order, which block can fit the given number of frames.
+static usz BuddyOrderForCount(usz count)
+{
+	usz order = 0;
+	while ((1ULL << order) < count) {
+		order++;
+	}
+
+	return order;
+}
+
+Result BuddyFrameAllocatorInit(BuddyFrameAllocator* frameAllocator, MemoryMapEntry* memoryMap, usz memoryMapEntries)
+{
+	// I assume the last entry is a "NULL-descriptor" so I just skip it
+	Frame4KiB lastFrame = Frame4KiBContaining(memoryMap[memoryMapEntries - 2].PhysicalEnd);
+
+	// Free blocks are linked through their own memory, so only the frames reachable through the physical memory mapping can be managed
+	const Frame4KiB lastMappedFrame = Frame4KiBContaining(g_bootInfo.PhysicalMemoryMappingSize - 1);
+	if (lastFrame > lastMappedFrame) {
+		lastFrame = lastMappedFrame;
+	}
+
+	// The frame metadata array comes first, so it stays cache line aligned, followed by one byte per frame, rounded up to the frame size
+	const usz frameInfoBytes = FrameInfoBytes(lastFrame);
+	const usz neededFrames = (frameInfoBytes + (lastFrame / FRAME_4KIB_SIZE_BYTES) + 1 + FRAME_4KIB_SIZE_BYTES - 1) / FRAME_4KIB_SIZE_BYTES;
+
+	if (neededFrames >= ((memoryMap[0].PhysicalEnd + 1 - memoryMap[0].PhysicalStart) / FRAME_4KIB_SIZE_BYTES)) {
+		LogLine(SK_LOG_ERROR "There is not enough contiguous physical frames to allocate the buddy allocator's frame orders and metadata");
+		return ResultNotEnoughMemoryFrames;
+	}
+
+	FrameInfoInit(PhysAddrAsPointer(memoryMap[0].PhysicalStart), lastFrame);
+
+	frameAllocator->MemoryMap = memoryMap;
+	frameAllocator->MemoryMapEntries = memoryMapEntries;
+	frameAllocator->FrameOrders = PhysAddrAsPointer(memoryMap[0].PhysicalStart + frameInfoBytes);
+	frameAllocator->LastFrame = lastFrame;
+
+	// Because we "allocate" the needed contiguous frames, we offset the descriptor physical start to reflect it
+	memoryMap[0].PhysicalStart += neededFrames * FRAME_4KIB_SIZE_BYTES;
+
+	// Every frame starts off as allocated
+	MemoryFill(frameAllocator->FrameOrders, 0, (lastFrame / FRAME_4KIB_SIZE_BYTES) + 1);
+	for (usz node = 0; node < MAX_NUMA_NODES; node++) {
+		for (usz zone = 0; zone < FRAME_ZONE_COUNT; zone++) {
+			for (usz i = 0; i <= BUDDY_MAX_ORDER; i++) {
+				frameAllocator->FreeLists[node][zone][i] = nullptr;
+			}
+		}
+	}
+
+	for (usz i = 0; i <= BUDDY_MAX_ORDER; i++) {
+		frameAllocator->FreeBlocks[i] = 0;
+	}
+
+	for (usz zone = 0; zone < FRAME_ZONE_COUNT; zone++) {
+		frameAllocator->TotalFrames[zone] = 0;
+		frameAllocator->FreeFrames[zone] = 0;
+	}
+
+	// Then we free frames in the memory map since the map only contains available memory regions,
+	// but only enough of them to boot, the rest is left for `BuddyFreeDeferredFrames` so boot time doesn't depend on the amount of RAM
+	frameAllocator->DeferredEntry = 0;
+	frameAllocator->DeferredFrame = 0;
+	frameAllocator->DeferredFrames = 0;
+
+	for (usz i = 0; i < memoryMapEntries - 2; i++) {
+		const Frame4KiB regionStart = Frame4KiBContaining(memoryMap[i].PhysicalStart);
+		Frame4KiB regionEnd = Frame4KiBContaining(memoryMap[i].PhysicalEnd);
+
+		if (regionStart > lastFrame) {
+			continue;
+		}
+
+		if (regionEnd > lastFrame) {
+			regionEnd = lastFrame;
+		}
+
+		for (usz zone = 0; zone < FRAME_ZONE_COUNT; zone++) {
+			frameAllocator->TotalFrames[zone] += FrameZoneFramesInRange(zone, regionStart, regionEnd);
+		}
+
+		frameAllocator->DeferredFrames += ((regionEnd - regionStart) / FRAME_4KIB_SIZE_BYTES) + 1;
+	}
+
+	FreeMemoryMapFrames(frameAllocator, BUDDY_BOOT_FRAMES);
+
+	return ResultOk;
+}
+
+Result BuddyAllocateBlock(BuddyFrameAllocator* frameAllocator, u8 node, FrameZone zone, usz order, Frame4KiB* frame)
+{
+	if (order > BUDDY_MAX_ORDER) {
+		return ResultOutOfRange;
+	}
+
+	if (node >= g_numa.NodeCount) {
+		return ResultOutOfRange;
+	}
+
+	BuddyFreeBlock** freeLists = frameAllocator->FreeLists[node][zone];
+
+	usz currentOrder = order;
+	while (currentOrder <= BUDDY_MAX_ORDER && !freeLists[currentOrder]) {
+		currentOrder++;
+	}
+
+	if (currentOrder > BUDDY_MAX_ORDER) {
+		return ResultOutOfMemory;
+	}
+
+	const Frame4KiB block = BuddyBlockFrame(freeLists[currentOrder]);
+	FreeListRemove(frameAllocator, block, currentOrder);
+
+	// Split the block in halves until it's of the requested size, giving back the upper ones
+	while (currentOrder > order) {
+		currentOrder--;
+		FreeListPush(frameAllocator, block + (FRAME_4KIB_SIZE_BYTES << currentOrder), currentOrder);
+	}
+
+	*frame = block;
+	return ResultOk;
+}
+
+Result BuddyDeallocateBlock(BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz order)
+{
+	if (order > BUDDY_MAX_ORDER) {
+		return ResultOutOfRange;
+	}
+
+	if (!__builtin_is_aligned(frame, FRAME_4KIB_SIZE_BYTES << order)) {
+		return ResultInvalidFrameAlignment;
+	}
+
+	if (frame + ((FRAME_4KIB_SIZE_BYTES << order) - FRAME_4KIB_SIZE_BYTES) > frameAllocator->LastFrame) {
+		return ResultOutOfRange;
+	}
+
+	if (BuddyRangeIsFree(frameAllocator, frame, 1ULL << order)) {
+		return ResultFrameAlreadyDeallocated;
+	}
+
+	FreeBlock(frameAllocator, frame, order);
+
+	return ResultOk;
+}
+
+Result BuddyAllocateFrame(BuddyFrameAllocator* frameAllocator, u8 node, FrameZone zone, Frame4KiB* frame)
+{
+	return BuddyAllocateBlock(frameAllocator, node, zone, 0, frame);
+}
+
+Result BuddyAllocateContiguousFrames(BuddyFrameAllocator* frameAllocator, u8 node, FrameZone zone, usz count, Frame4KiB* frame)
+{
+	if (count == 0) {
+		return ResultOutOfRange;
+	}
+
+	const usz order = BuddyOrderForCount(count);
+
+	Result result = BuddyAllocateBlock(frameAllocator, node, zone, order, frame);
+	if (result) {
+		return result;
+	}
+
+	// Blocks always consist of a power of two frames, so the rest of it is not needed
+	FreeRange(frameAllocator, *frame + (count * FRAME_4KIB_SIZE_BYTES), (1ULL << order) - count);
+
+	return result;
+}
+
+void BuddyDeallocateFrame(BuddyFrameAllocator* frameAllocator, Frame4KiB frame)
+{
+	Result result = BuddyDeallocateBlock(frameAllocator, frame, 0);
+
+	if (result) {
+		LogLine(SK_LOG_WARN "An attempt was made to deallocate an unallocated memory frame");
+	}
+}
+
+Result BuddyDeallocateContiguousFrames(BuddyFrameAllocator* frameAllocator, Frame4KiB frame, usz count)
+{
+	if (!Frame4KiBAlignCheck(frame)) {
+		return ResultInvalidFrameAlignment;
+	}
+
+	if (frame + (count * FRAME_4KIB_SIZE_BYTES) > frameAllocator->LastFrame + FRAME_4KIB_SIZE_BYTES) {
+		return ResultOutOfRange;
+	}
+
+	if (BuddyRangeIsFree(frameAllocator, frame, count)) {
+		return ResultFrameAlreadyDeallocated;
+	}
+
+	FreeRange(frameAllocator, frame, count);
+
+	return ResultOk;
+}
+
+void BuddyFreeRunHistogram(const BuddyFrameAllocator* frameAllocator, usz* runs, usz buckets, usz* largestRun)
+{
+	*largestRun = 0;
+
+	for (usz i = 0; i < buckets; i++) {
+		runs[i] = 0;
+	}
+
+	for (usz order = 0; order <= BUDDY_MAX_ORDER; order++) {
+		runs[order < buckets ? order : buckets - 1] += frameAllocator->FreeBlocks[order];
+
+		if (frameAllocator->FreeBlocks[order]) {
+			*largestRun = 1ULL << order;
+		}
+	}
+}
+
+usz BuddyFreeDeferredFrames(BuddyFrameAllocator* frameAllocator, usz maxFrames) { return FreeMemoryMapFrames(frameAllocator, maxFrames); }
@@ -0,0 +1,457 @@
+#include "Memory/FrameAllocator.h"
+
+#include "IDT.h"
+#include "Logger.h"
+#include "Memory.h"
+#include "Memory/FrameInfo.h"
+#include "NUMA.h"
+#include "Panic.h"
+
+FrameAllocator g_frameAllocator = {};
+
+Result FrameAllocatorInit(FrameAllocator* frameAllocator, FrameAllocatorEngine engine, MemoryMapEntry* memoryMap, usz memoryMapEntries)
+{
+	frameAllocator->Engine = engine;
+
+	if (engine == FrameAllocatorBuddy) {
+		return BuddyFrameAllocatorInit(&frameAllocator->Buddy, memoryMap, memoryMapEntries);
+	}
+
+	return BitmapFrameAllocatorInit(&frameAllocator->Bitmap, memoryMap, memoryMapEntries);
+}
+
+/// Frees another batch of the memory left out at boot, returns false when there's nothing left to free.
+static bool EngineFreeDeferredFrames(FrameAllocator* frameAllocator)
+{
+	if (frameAllocator->Engine == FrameAllocatorBuddy) {
+		return BuddyFreeDeferredFrames(&frameAllocator->Buddy, DEFERRED_FRAMES_BATCH) > 0;
+	}
+
+	return BitmapFreeDeferredFrames(&frameAllocator->Bitmap, DEFERRED_FRAMES_BATCH) > 0;
+}
+
+/// Allocates a frame from the given zone of the given node, falling back to the more constrained zones below it when it's exhausted,
+/// and then to the other nodes, from the closest one to the furthest one.
+static Result EngineAllocateFrame(FrameAllocator* frameAllocator, u8 node, FrameZone zone, Frame4KiB* frame)
+{
+	Result result = ResultOutOfMemory;
+
+	for (usz n = 0; n < g_numa.NodeCount; n++) {
+		const u8 fallbackNode = g_numa.FallbackOrder[node][n];
+
+		for (i32 i = zone; i >= 0; i--) {
+			if (frameAllocator->Engine == FrameAllocatorBuddy) {
+				result = BuddyAllocateFrame(&frameAllocator->Buddy, fallbackNode, (FrameZone)i, frame);
+			} else {
+				result = BitmapAllocateFrame(&frameAllocator->Bitmap, fallbackNode, (FrameZone)i, frame);
+			}
+
+			if (!result) {
+				return result;
+			}
+		}
+	}
+
+	// The memory might just not have been made available yet
+	if (EngineFreeDeferredFrames(frameAllocator)) {
+		return EngineAllocateFrame(frameAllocator, node, zone, frame);
+	}
+
+	return result;
+}
+
+/// Same as `EngineAllocateFrame`, but for a contiguous range of frames.
+static Result EngineAllocateContiguousFrames(FrameAllocator* frameAllocator, u8 node, FrameZone zone, usz count, Frame4KiB* frame)
+{
+	Result result = ResultOutOfMemory;
+
+	for (usz n = 0; n < g_numa.NodeCount; n++) {
+		const u8 fallbackNode = g_numa.FallbackOrder[node][n];
+
+		for (i32 i = zone; i >= 0; i--) {
+			if (frameAllocator->Engine == FrameAllocatorBuddy) {
+				result = BuddyAllocateContiguousFrames(&frameAllocator->Buddy, fallbackNode, (FrameZone)i, count, frame);
+			} else {
+				result = BitmapAllocateContiguousFrames(&frameAllocator->Bitmap, fallbackNode, (FrameZone)i, count, frame);
+			}
+
+			if (result != ResultOutOfMemory) {
+				return result;
+			}
+		}
+	}
+
+	if (EngineFreeDeferredFrames(frameAllocator)) {
+		return EngineAllocateContiguousFrames(frameAllocator, node, zone, count, frame);
+	}
+
+	return result;
+}
+
+/// Gives a contiguous range of frames straight back to the engine.
+static Result EngineDeallocateContiguousFrames(FrameAllocator* frameAllocator, Frame4KiB frame, usz count)
+{
+	if (frameAllocator->Engine == FrameAllocatorBuddy) {
+		return BuddyDeallocateContiguousFrames(&frameAllocator->Buddy, frame, count);
+	}
+
+	return BitmapDeallocateContiguousFrames(&frameAllocator->Bitmap, frame, count);
+}
+
+/// Resets the metadata of a frame about to be handed out, tagging it with the current CPU's tag.
+static Frame4KiB TrackFrame(FrameAllocator* frameAllocator, Frame4KiB frame)
+{
+	const FrameTag tag = frameAllocator->Tags[CPUCurrentIndex()];
+
+	FrameInfoReset(frame, tag);
+	frameAllocator->TaggedFrames[tag]++;
+
+	return frame;
+}
+
+/// Clears the metadata of a frame given back to the allocator.
+static void UntrackFrame(FrameAllocator* frameAllocator, Frame4KiB frame)
+{
+	FrameInfo* info = FrameInfoOf(frame);
+
+	frameAllocator->TaggedFrames[info->Tag]--;
+	*info = (FrameInfo) {};
+}
+
+static void EngineDeallocateFrame(FrameAllocator* frameAllocator, Frame4KiB frame)
+{
+	if (frameAllocator->Engine == FrameAllocatorBuddy) {
+		BuddyDeallocateFrame(&frameAllocator->Buddy, frame);
+		return;
+	}
+
+	BitmapDeallocateFrame(&frameAllocator->Bitmap, frame);
+}
+
+Frame4KiB AllocateFrame(FrameAllocator* frameAllocator)
+{
+	FrameMagazine* magazine = &frameAllocator->Magazines[CPUCurrentIndex()];
+
+	if (magazine->Count > 0) {
+		magazine->Hits++;
+		return TrackFrame(frameAllocator, magazine->Frames[--magazine->Count]);
+	}
+
+	magazine->Misses++;
+
+	// Refill the magazine with a whole batch from the CPU's own node, so the following allocations don't have to touch the engine
+	const u8 node = NUMACurrentNode();
+	while (magazine->Count < FRAME_MAGAZINE_BATCH) {
+		Frame4KiB frame;
+		if (EngineAllocateFrame(frameAllocator, node, FrameZoneNormal, &frame)) {
+			break;
+		}
+
+		magazine->Frames[magazine->Count++] = frame;
+	}
+
+	if (magazine->Count > 0) {
+		return TrackFrame(frameAllocator, magazine->Frames[--magazine->Count]);
+	}
+
+	// Frames waiting in the zeroed frame pool are the last resort
+	ZeroedFramePool* pool = &frameAllocator->ZeroedFrames;
+	const bool interrupts = SaveAndDisableInterrupts();
+	if (pool->Count == 0) {
+		SK_PANIC("The kernel ran out of memory");
+	}
+
+	const Frame4KiB frame = pool->Frames[--pool->Count];
+	RestoreInterrupts(interrupts);
+
+	return TrackFrame(frameAllocator, frame);
+}
+
+Frame4KiB AllocateZeroedFrame(FrameAllocator* frameAllocator)
+{
+	ZeroedFramePool* pool = &frameAllocator->ZeroedFrames;
+
+	// The pool gets refilled by the idle loop, which must not be interrupted by an allocation halfway through it
+	const bool interrupts = SaveAndDisableInterrupts();
+	if (pool->Count > 0) {
+		pool->Hits++;
+		const Frame4KiB frame = pool->Frames[--pool->Count];
+		RestoreInterrupts(interrupts);
+
+		return TrackFrame(frameAllocator, frame);
+	}
+
+	pool->Misses++;
+	RestoreInterrupts(interrupts);
+
+	Frame4KiB frame = AllocateFrame(frameAllocator);
+	MemoryFill(PhysAddrAsPointer(frame), 0, FRAME_4KIB_SIZE_BYTES);
+
+	return frame;
+}
+
+bool RefillZeroedFrame(FrameAllocator* frameAllocator)
+{
+	ZeroedFramePool* pool = &frameAllocator->ZeroedFrames;
+
+	if (pool->Count >= ZEROED_FRAME_POOL_CAPACITY) {
+		return false;
+	}
+
+	// Interrupt handlers and syscalls allocate frames with interrupts disabled,
+	// so they must not interrupt us in the middle of touching the allocator's state
+	Frame4KiB frame;
+	bool interrupts = SaveAndDisableInterrupts();
+	Result result = EngineAllocateFrame(frameAllocator, NUMACurrentNode(), FrameZoneNormal, &frame);
+	RestoreInterrupts(interrupts);
+
+	if (result) {
+		return false;
+	}
+
+	// The actual zeroing is the slow part, so it's the one done with interrupts enabled
+	MemoryFill(PhysAddrAsPointer(frame), 0, FRAME_4KIB_SIZE_BYTES);
+
+	interrupts = SaveAndDisableInterrupts();
+	pool->Frames[pool->Count++] = frame;
+	RestoreInterrupts(interrupts);
+
+	return true;
+}
+
+bool FreeDeferredFrames(FrameAllocator* frameAllocator)
+{
+	const bool interrupts = SaveAndDisableInterrupts();
+	bool remaining = EngineFreeDeferredFrames(frameAllocator);
+	RestoreInterrupts(interrupts);
+
+	return remaining;
+}
+
+Result AllocateFrameInZone(FrameAllocator* frameAllocator, FrameZone zone, Frame4KiB* frame)
+{
+	Result result = EngineAllocateFrame(frameAllocator, NUMACurrentNode(), zone, frame);
+	if (!result) {
+		TrackFrame(frameAllocator, *frame);
+	}
+
+	return result;
+}
+
+Result AllocateFrameOnNode(FrameAllocator* frameAllocator, u8 node, FrameZone zone, Frame4KiB* frame)
+{
+	if (node >= g_numa.NodeCount) {
+		return ResultOutOfRange;
+	}
+
+	Result result = EngineAllocateFrame(frameAllocator, node, zone, frame);
+	if (!result) {
+		TrackFrame(frameAllocator, *frame);
+	}
+
+	return result;
+}
+
+Result AllocateContiguousFrames(FrameAllocator* frameAllocator, usz count, Frame4KiB* frame)
+{
+	return AllocateContiguousFramesInZone(frameAllocator, FrameZoneNormal, count, frame);
+}
+
+Result AllocateContiguousFramesInZone(FrameAllocator* frameAllocator, FrameZone zone, usz count, Frame4KiB* frame)
+{
+	Result result = EngineAllocateContiguousFrames(frameAllocator, NUMACurrentNode(), zone, count, frame);
+	if (result) {
+		return result;
+	}
+
+	for (usz i = 0; i < count; i++) {
+		TrackFrame(frameAllocator, *frame + (i * FRAME_4KIB_SIZE_BYTES));
+	}
+
+	return result;
+}
+
+Result AllocateAlignedContiguousFrames(FrameAllocator* frameAllocator, usz count, usz alignment, Frame4KiB* frame)
+{
+	// The alignment has to be a power of two of at least a single frame
+	if (count == 0 || alignment < FRAME_4KIB_SIZE_BYTES || (alignment & (alignment - 1))) {
+		return ResultInvalidFrameAlignment;
+	}
+
+	const usz alignmentFrames = alignment / FRAME_4KIB_SIZE_BYTES;
+
+	// Buddy blocks are aligned to their own size, which is never smaller than the count, so only the bitmap needs a larger range
+	usz extraFrames = alignmentFrames - 1;
+	if (frameAllocator->Engine == FrameAllocatorBuddy && alignmentFrames <= count) {
+		extraFrames = 0;
+	}
+
+	Frame4KiB rangeBegin;
+	Result result = EngineAllocateContiguousFrames(frameAllocator, NUMACurrentNode(), FrameZoneNormal, count + extraFrames, &rangeBegin);
+	if (result) {
+		return result;
+	}
+
+	// Whatever is left over on either side of the aligned frames goes straight back,
+	// the engine has just handed all of them out, so failing to take them back means its state is broken
+	const Frame4KiB alignedBegin = __builtin_align_up(rangeBegin, alignment);
+	const usz headFrames = (alignedBegin - rangeBegin) / FRAME_4KIB_SIZE_BYTES;
+	const usz tailFrames = extraFrames - headFrames;
+
+	if (headFrames > 0) {
+		SK_PANIC_ON_ERROR(EngineDeallocateContiguousFrames(frameAllocator, rangeBegin, headFrames),
+			"Could not give back the frames in front of an aligned range");
+	}
+
+	if (tailFrames > 0) {
+		SK_PANIC_ON_ERROR(EngineDeallocateContiguousFrames(frameAllocator, alignedBegin + (count * FRAME_4KIB_SIZE_BYTES), tailFrames),
+			"Could not give back the frames behind an aligned range");
+	}
+
+	for (usz i = 0; i < count; i++) {
+		TrackFrame(frameAllocator, alignedBegin + (i * FRAME_4KIB_SIZE_BYTES));
+	}
+
+	*frame = alignedBegin;
+	return result;
+}
+
+void DeallocateFrame(FrameAllocator* frameAllocator, Frame4KiB frame)
+{
+	// Frames sitting in a magazine still count as allocated for the engine, so it can't catch them being deallocated twice
+	if (frame / FRAME_4KIB_SIZE_BYTES >= g_frameInfoCount || FrameInfoOf(frame)->ReferenceCount == 0) {
+		LogLine(SK_LOG_WARN "An attempt was made to deallocate an unallocated memory frame");
+		return;
+	}
+
+	UntrackFrame(frameAllocator, frame);
+
+	// Frames of other nodes go straight back to the engine, so the magazine only ever hands out local memory
+	if (NUMANodeContaining(frame) != NUMACurrentNode()) {
+		EngineDeallocateFrame(frameAllocator, frame);
+		return;
+	}
+
+	FrameMagazine* magazine = &frameAllocator->Magazines[CPUCurrentIndex()];
+
+	// Drain a whole batch back to the engine, leaving some room for the following deallocations
+	if (magazine->Count == FRAME_MAGAZINE_CAPACITY) {
+		for (usz i = 0; i < FRAME_MAGAZINE_BATCH; i++) {
+			EngineDeallocateFrame(frameAllocator, magazine->Frames[--magazine->Count]);
+		}
+	}
+
+	magazine->Frames[magazine->Count++] = frame;
+}
+
+Result DeallocateContiguousFrames(FrameAllocator* frameAllocator, Frame4KiB frame, usz count)
+{
+	Result result = EngineDeallocateContiguousFrames(frameAllocator, frame, count);
+	if (result) {
+		return result;
+	}
+
+	for (usz i = 0; i < count; i++) {
+		UntrackFrame(frameAllocator, frame + (i * FRAME_4KIB_SIZE_BYTES));
+	}
+
+	return result;
+}
+
+void FrameAllocatorPrintMagazines(FrameAllocator* frameAllocator)
+{
+	const ZeroedFramePool* pool = &frameAllocator->ZeroedFrames;
+	LogLine(SK_LOG_DEBUG "Zeroed frame pool: Frames = %u Hits = %u Misses = %u", pool->Count, pool->Hits, pool->Misses);
+
+	for (usz i = 0; i < MAX_CPUS; i++) {
+		const FrameMagazine* magazine = &frameAllocator->Magazines[i];
+		if (magazine->Hits == 0 && magazine->Misses == 0) {
+			continue;
+		}
+
+		LogLine(SK_LOG_DEBUG "Frame magazine of CPU %u: Frames = %u Hits = %u Misses = %u", i, magazine->Count, magazine->Hits,
+			magazine->Misses);
+	}
+}
+
+FrameTag FrameAllocatorSetTag(FrameAllocator* frameAllocator, FrameTag tag)
+{
+	const FrameTag previousTag = frameAllocator->Tags[CPUCurrentIndex()];
+	frameAllocator->Tags[CPUCurrentIndex()] = tag;
+
+	return previousTag;
+}
+
+void FrameAllocatorRetag(FrameAllocator* frameAllocator, Frame4KiB frame, usz count, FrameTag tag)
+{
+	for (usz i = 0; i < count; i++) {
+		FrameInfo* info = FrameInfoOf(frame + (i * FRAME_4KIB_SIZE_BYTES));
+
+		frameAllocator->TaggedFrames[info->Tag]--;
+		frameAllocator->TaggedFrames[tag]++;
+		info->Tag = tag;
+	}
+}
+
+void FrameAllocatorGetStatistics(FrameAllocator* frameAllocator, FrameStatistics* statistics)
+{
+	MemoryFill(statistics, 0, sizeof(FrameStatistics));
+
+	if (frameAllocator->Engine == FrameAllocatorBuddy) {
+		for (usz zone = 0; zone < FRAME_ZONE_COUNT; zone++) {
+			statistics->TotalFrames[zone] = frameAllocator->Buddy.TotalFrames[zone];
+			statistics->FreeFrames[zone] = frameAllocator->Buddy.FreeFrames[zone];
+		}
+
+		statistics->DeferredFrames = frameAllocator->Buddy.DeferredFrames;
+		BuddyFreeRunHistogram(&frameAllocator->Buddy, statistics->FreeRuns, FRAME_RUN_HISTOGRAM_BUCKETS, &statistics->LargestFreeRun);
+	} else {
+		for (usz zone = 0; zone < FRAME_ZONE_COUNT; zone++) {
+			statistics->TotalFrames[zone] = frameAllocator->Bitmap.TotalFrames[zone];
+			statistics->FreeFrames[zone] = frameAllocator->Bitmap.FreeFrames[zone];
+		}
+
+		statistics->DeferredFrames = frameAllocator->Bitmap.DeferredFrames;
+		BitmapFreeRunHistogram(&frameAllocator->Bitmap, statistics->FreeRuns, FRAME_RUN_HISTOGRAM_BUCKETS, &statistics->LargestFreeRun);
+	}
+
+	statistics->CachedFrames = frameAllocator->ZeroedFrames.Count;
+	for (usz i = 0; i < MAX_CPUS; i++) {
+		statistics->CachedFrames += frameAllocator->Magazines[i].Count;
+	}
+
+	for (usz tag = 0; tag < FRAME_TAG_COUNT; tag++) {
+		statistics->TaggedFrames[tag] = frameAllocator->TaggedFrames[tag];
+	}
+}
+
+void FrameAllocatorPrintStatistics(FrameAllocator* frameAllocator)
+{
+	static const i8* zoneNames[FRAME_ZONE_COUNT] = { "DMA32", "Normal" };
+	static const i8* tagNames[FRAME_TAG_COUNT]
+		= { "Untagged", "Page tables", "AHCI", "Scheduler", "ELF segments", "File systems", "Shared memory" };
+
+	FrameStatistics statistics;
+	FrameAllocatorGetStatistics(frameAllocator, &statistics);
+
+	// Cached and deferred frames aren't available to the engine, so they count as used here and get reported separately
+	for (usz zone = 0; zone < FRAME_ZONE_COUNT; zone++) {
+		LogLine(SK_LOG_DEBUG "Zone %s: Total = %u Free = %u Used = %u", zoneNames[zone], statistics.TotalFrames[zone],
+			statistics.FreeFrames[zone], statistics.TotalFrames[zone] - statistics.FreeFrames[zone]);
+	}
+
+	LogLine(SK_LOG_DEBUG "Cached frames = %u Deferred frames = %u Largest free run = %u", statistics.CachedFrames,
+		statistics.DeferredFrames, statistics.LargestFreeRun);
+
+	for (usz i = 0; i < FRAME_RUN_HISTOGRAM_BUCKETS; i++) {
+		if (statistics.FreeRuns[i]) {
+			LogLine(SK_LOG_DEBUG "Free runs of %u or more frames: %u", 1ULL << i, statistics.FreeRuns[i]);
+		}
+	}
+
+	for (usz tag = 0; tag < FRAME_TAG_COUNT; tag++) {
+		LogLine(SK_LOG_DEBUG "%s: %u frames", tagNames[tag], statistics.TaggedFrames[tag]);
+	}
+
+	FrameAllocatorPrintMagazines(frameAllocator);
+}
@@ -0,0 +1,48 @@
+#include "Memory/FrameInfo.h"
+
+#include "Logger.h"
+#include "Memory.h"
+#include "Memory/FrameAllocator.h"
+
+FrameInfo* g_frameInfos = nullptr;
+usz g_frameInfoCount = 0;
+
+void FrameInfoInit(void* storage, Frame4KiB lastFrame)
+{
+	g_frameInfos = storage;
+	g_frameInfoCount = (lastFrame / FRAME_4KIB_SIZE_BYTES) + 1;
+}
+
+void FrameInfoClear(Frame4KiB frame, usz count) { MemoryFill(FrameInfoOf(frame), 0, count * sizeof(FrameInfo)); }
+
+void FrameGet(Frame4KiB frame)
+{
+	FrameInfo* info = FrameInfoOf(frame);
+
+	if (info->ReferenceCount == 0) {
+		LogLine(SK_LOG_WARN "An attempt was made to reference an unallocated memory frame: 0x%x", frame);
+		return;
+	}
+
+	info->ReferenceCount++;
+}
+
+bool FramePut(Frame4KiB frame)
+{
+	FrameInfo* info = FrameInfoOf(frame);
+
+	if (info->ReferenceCount == 0) {
+		LogLine(SK_LOG_WARN "An attempt was made to put an unreferenced memory frame: 0x%x", frame);
+		return false;
+	}
+
+	if (info->ReferenceCount > 1) {
+		info->ReferenceCount--;
+		return false;
+	}
+
+	// The last reference is dropped by the deallocation itself, which refuses frames without any references
+	DeallocateFrame(&g_frameAllocator, frame);
+
+	return true;
+}
@@ -0,0 +1,110 @@
+#include "Memory/Heap.h"
+
+#include "Logger.h"
+#include "Memory/Page.h"
+#include "Memory/VirtualMemoryAllocator.h"
+
+KernelHeap g_kernelHeap;
+
+/// Returns the index of the smallest size class fitting the given number of bytes, which must not be above the largest one.
+static usz SizeClassIndex(usz sizeBytes)
+{
+	if (sizeBytes <= HEAP_SMALLEST_SIZE_CLASS_BYTES) {
+		return 0;
+	}
+
+	// The number of bits needed for `sizeBytes - 1` is the power of two of the class, the smallest class being 2^3
+	return (64 - __builtin_clzll(sizeBytes - 1)) - 3;
+}
+
+Result InitKernelHeap(KernelHeap* heap)
+{
+	for (usz i = 0; i < HEAP_SIZE_CLASS_COUNT; i++) {
+		Result result = InitSlabCache(&heap->SizeClasses[i].Cache, HEAP_SMALLEST_SIZE_CLASS_BYTES << i);
+		if (result) {
+			return result;
+		}
+
+		heap->SizeClasses[i].Allocations = 0;
+		heap->SizeClasses[i].Deallocations = 0;
+	}
+
+	heap->LargeAllocations = 0;
+	heap->LargeDeallocations = 0;
+	heap->LargeBytes = 0;
+
+	return ResultOk;
+}
+
+Result HeapAllocate(KernelHeap* heap, usz sizeBytes, void** allocation)
+{
+	if (sizeBytes == 0) {
+		return ResultOutOfRange;
+	}
+
+	if (sizeBytes > HEAP_LARGEST_SIZE_CLASS_BYTES) {
+		const usz pagesBytes = Page4KiBNext(sizeBytes);
+
+		Result result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, pagesBytes, PageWriteable, allocation);
+		if (result) {
+			return result;
+		}
+
+		heap->LargeAllocations++;
+		heap->LargeBytes += pagesBytes;
+
+		return result;
+	}
+
+	HeapSizeClass* sizeClass = &heap->SizeClasses[SizeClassIndex(sizeBytes)];
+
+	Result result = SlabCacheAllocate(&sizeClass->Cache, allocation);
+	if (result) {
+		return result;
+	}
+
+	sizeClass->Allocations++;
+
+	return result;
+}
+
+Result HeapDeallocate(KernelHeap* heap, void* allocation, usz sizeBytes)
+{
+	if (sizeBytes == 0) {
+		return ResultOutOfRange;
+	}
+
+	if (sizeBytes > HEAP_LARGEST_SIZE_CLASS_BYTES) {
+		const usz pagesBytes = Page4KiBNext(sizeBytes);
+
+		Result result = DeallocateBackedVirtualMemory(&g_kernelMemoryAllocator, allocation, pagesBytes);
+		if (result) {
+			return result;
+		}
+
+		heap->LargeDeallocations++;
+		heap->LargeBytes -= pagesBytes;
+
+		return result;
+	}
+
+	HeapSizeClass* sizeClass = &heap->SizeClasses[SizeClassIndex(sizeBytes)];
+
+	SlabCacheDeallocate(&sizeClass->Cache, allocation);
+	sizeClass->Deallocations++;
+
+	return ResultOk;
+}
+
+void HeapPrintStatistics(KernelHeap* heap)
+{
+	for (usz i = 0; i < HEAP_SIZE_CLASS_COUNT; i++) {
+		const HeapSizeClass* sizeClass = &heap->SizeClasses[i];
+
+		LogLine(SK_LOG_DEBUG "Heap %u B: Used = %u Slabs = %u Allocations = %u Deallocations = %u", HEAP_SMALLEST_SIZE_CLASS_BYTES << i,
+			sizeClass->Cache.ObjectCount, sizeClass->Cache.SlabCount, sizeClass->Allocations, sizeClass->Deallocations);
+	}
+
+	LogLine(SK_LOG_DEBUG "Heap large: Bytes = %u Allocations = %u Deallocations = %u", heap->LargeBytes, heap->LargeAllocations,
+		heap->LargeDeallocations);
+}
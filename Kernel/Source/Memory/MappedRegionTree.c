@@ -0,0 +1,78 @@
+#include "Memory/MappedRegionTree.h"
+
+Result InitMappedRegionTree(MappedRegionTree* tree)
+{
+	InitRangeTree(&tree->Regions, nullptr);
+
+	return InitSlabCache(&tree->RegionCache, sizeof(MappedRegion));
+}
+
+void MappedRegionTreeRelease(MappedRegionTree* tree)
+{
+	SlabCacheRelease(&tree->RegionCache);
+	tree->Regions.Root = nullptr;
+}
+
+Result MappedRegionAdd(MappedRegionTree* tree, Page4KiB begin, Page4KiB end, PageTableEntryFlags flags, MappedRegionBacking backing)
+{
+	if (!Page4KiBIsAligned(begin) || !Page4KiBIsAligned(end)) {
+		return ResultInvalidPageAlignment;
+	}
+
+	const RangeTreeNode* below = RangeTreeFloor(&tree->Regions, begin);
+	const RangeTreeNode* above = RangeTreeCeiling(&tree->Regions, begin);
+	if (begin >= end || (below && below->End > begin) || (above && above->Begin < end)) {
+		return ResultPageAlreadyMapped;
+	}
+
+	MappedRegion* region;
+	Result result = SlabCacheAllocate(&tree->RegionCache, (void**)&region);
+	if (result) {
+		return result;
+	}
+
+	region->Node.Begin = begin;
+	region->Node.End = end;
+	region->Flags = flags;
+	region->Backing = backing;
+	RangeTreeInsert(&tree->Regions, &region->Node);
+
+	return result;
+}
+
+Result MappedRegionRemove(MappedRegionTree* tree, Page4KiB begin)
+{
+	RangeTreeNode* region = RangeTreeRemove(&tree->Regions, begin);
+	if (!region) {
+		return ResultNotFound;
+	}
+
+	SlabCacheDeallocate(&tree->RegionCache, region);
+
+	return ResultOk;
+}
+
+MappedRegion* MappedRegionFind(const MappedRegionTree* tree, VirtAddr address)
+{
+	RangeTreeNode* region = RangeTreeFloor(&tree->Regions, address);
+	if (!region || address >= region->End) {
+		return nullptr;
+	}
+
+	// The regions' nodes are their first members
+	return (MappedRegion*)region;
+}
+
+static Result CopyRegion(const RangeTreeNode* node, void* destination)
+{
+	const MappedRegion* region = (const MappedRegion*)node;
+
+	return MappedRegionAdd(destination, node->Begin, node->End, region->Flags, region->Backing);
+}
+
+Result MappedRegionTreeCopy(MappedRegionTree* destination, const MappedRegionTree* source)
+{
+	MappedRegionTreeRelease(destination);
+
+	return RangeTreeWalk(&source->Regions, CopyRegion, destination);
+}
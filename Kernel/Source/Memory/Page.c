@@ -1,161 +1,801 @@
 #include "Memory/Page.h"
 
 #include "Logger.h"
-#include "Memory/BitmapFrameAllocator.h"
+#include "Memory.h"
 #include "Memory/Frame.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/FrameInfo.h"
 #include "Memory/PageTable.h"
+#include "Memory/TLB.h"
 #include "Memory/VirtAddr.h"
 
+Frame4KiB AllocatePageTable()
+{
+	Frame4KiB frame = AllocateZeroedFrame(&g_frameAllocator);
+
+	FrameAllocatorRetag(&g_frameAllocator, frame, 1, FrameTagPageTable);
+	FrameInfoOf(frame)->Flags |= FrameInfoPageTable;
+
+	return frame;
+}
+
+/// The flags of a leaf entry that also have to be set in every entry above it to take effect.
+constexpr u64 UPPER_LEVEL_FLAGS = PageWriteable | PageUserAccessible;
+
+/// Kernel pages are mapped into every address space, so they're always global.
+static PageTableEntryFlags LeafFlags(VirtAddr page, PageTableEntryFlags flags)
+{
+	return page >= KERNEL_HALF_BEGIN ? flags | PageGlobal : flags;
+}
+
+/// The number of 4 KiB pages covered by a single 2 MiB and 1 GiB page.
+constexpr usz PAGE_2MIB_PAGES = PAGE_2MIB_SIZE_BYTES / PAGE_4KIB_SIZE_BYTES;
+constexpr usz PAGE_1GIB_PAGES = PAGE_1GIB_SIZE_BYTES / PAGE_4KIB_SIZE_BYTES;
+
+/// Returns the next level table an entry points to, creating it first if it's missing and `create` is set.
+static Result NextLevelTable(PageTableEntry* entry, PageTableEntryFlags flags, bool create, PageTableEntry** table)
+{
+	if (!(*entry & PagePresent)) {
+		if (!create) {
+			return ResultPageAlreadyUnmapped;
+		}
+
+		*entry = AllocatePageTable() | PagePresent | PageWriteable;
+	}
+
+	// The entries above a leaf must be at least as permissive as the leaf itself
+	*entry |= flags & UPPER_LEVEL_FLAGS;
+
+	*table = PhysAddrAsPointer(*entry & FRAME_ADDRESS_MASK);
+	return ResultOk;
+}
+
+static bool IsHugeEntry(PageTableEntry entry) { return (entry & PagePresent) && (entry & PageHugePage); }
+
+/// Reserved pages don't have a frame yet, but their entries are still taken.
+static bool IsUsedEntry(PageTableEntry entry) { return entry & (PagePresent | PageLazy); }
+
+/// Checks whether the frame of a user half entry is referenced by another address space as well.
+/// Borrowed frames belong to somebody else, so they always count as shared.
+/// Shared memory objects' frames are meant to be written to from every address space, so they never do.
+static bool IsSharedFrame(VirtAddr page, PageTableEntry entry)
+{
+	if (page >= KERNEL_HALF_BEGIN || (entry & PageSharedMemory)) {
+		return false;
+	}
+
+	const Frame4KiB frame = entry & FRAME_ADDRESS_MASK;
+	return (entry & PageBorrowed) || (frame / FRAME_4KIB_SIZE_BYTES < g_frameInfoCount && FrameInfoOf(frame)->ReferenceCount > 1);
+}
+
+/// Where a walk down the page tables ended, either at the level 1 table covering a page or at the huge page containing it.
+typedef struct PageWalk {
+	PageTableEntry* P1Table;
+	/// Set instead of `P1Table` when the page is a part of a huge page.
+	PageTableEntry* HugeEntry;
+	/// The number of 4 KiB pages the huge page covers.
+	usz HugePages;
+	/// The entries pointing to the level 3, 2 and 1 tables the walk went through, only the first `Depth` of them are set.
+	PageTableEntry* TableEntries[3];
+	usz Depth;
+} PageWalk;
+
+/// Walks down to the level 1 table covering the given page, only once for every run of pages sharing it.
+static Result WalkToP1Table(PageTableEntry* p4Table, Page4KiB page, PageTableEntryFlags flags, bool create, PageWalk* walk)
+{
+	*walk = (PageWalk) {};
+
+	PageTableEntry* p4Entry = &p4Table[VirtAddrPage4Index(page)];
+	PageTableEntry* p3Table;
+	Result result = NextLevelTable(p4Entry, flags, create, &p3Table);
+	if (result) {
+		return result;
+	}
+
+	walk->TableEntries[walk->Depth++] = p4Entry;
+
+	PageTableEntry* p3Entry = &p3Table[VirtAddrPage3Index(page)];
+	if (IsHugeEntry(*p3Entry)) {
+		walk->HugeEntry = p3Entry;
+		walk->HugePages = PAGE_1GIB_PAGES;
+		return ResultOk;
+	}
+
+	PageTableEntry* p2Table;
+	result = NextLevelTable(p3Entry, flags, create, &p2Table);
+	if (result) {
+		return result;
+	}
+
+	walk->TableEntries[walk->Depth++] = p3Entry;
+
+	PageTableEntry* p2Entry = &p2Table[VirtAddrPage2Index(page)];
+	if (IsHugeEntry(*p2Entry)) {
+		walk->HugeEntry = p2Entry;
+		walk->HugePages = PAGE_2MIB_PAGES;
+		return ResultOk;
+	}
+
+	result = NextLevelTable(p2Entry, flags, create, &walk->P1Table);
+	if (result) {
+		return result;
+	}
+
+	walk->TableEntries[walk->Depth++] = p2Entry;
+
+	return ResultOk;
+}
+
+static bool TableIsEmpty(const PageTableEntry* table)
+{
+	for (usz i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+		if (IsUsedEntry(table[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// Only the tables of a process's user half can be released, as every one of them came from `AllocatePageTable`.
+/// The kernel half's tables are linked into every address space, and the kernel's own lower half was built by the bootloader,
+/// whose frames the frame allocator doesn't know about.
+static bool CanReleaseTables(const PageTableEntry* p4Table, VirtAddr page)
+{
+	return page < KERNEL_HALF_BEGIN && p4Table != PhysAddrAsPointer(g_bootInfo.KernelPML4);
+}
+
+/// Deallocates the tables the walk went through, from the lowest one up, for as long as they're left without any entries.
+/// Invalidating the unmapped pages afterwards also gets rid of any cached pointers to the released tables.
+static void ReleaseEmptyTables(const PageTableEntry* p4Table, const PageWalk* walk, VirtAddr page)
+{
+	if (!CanReleaseTables(p4Table, page)) {
+		return;
+	}
+
+	for (usz level = walk->Depth; level > 0; level--) {
+		PageTableEntry* entry = walk->TableEntries[level - 1];
+		const Frame4KiB table = *entry & FRAME_ADDRESS_MASK;
+
+		if (!TableIsEmpty(PhysAddrAsPointer(table))) {
+			return;
+		}
+
+		*entry = 0;
+		DeallocateFrame(&g_frameAllocator, table);
+	}
+}
+
+/// Replaces a huge page's entry with a table of 512 entries, each mapping the next smaller page size, with the same flags.
+static void SplitHugeEntry(PageTableEntry* entry, usz hugePages)
+{
+	const Frame4KiB tableFrame = AllocatePageTable();
+	PageTableEntry* table = PhysAddrAsPointer(tableFrame);
+
+	// Bit 12 is the PAT bit in huge entries, which isn't used, so it's just dropped together with the rest of the offset
+	const Frame4KiB frame = __builtin_align_down(*entry & FRAME_ADDRESS_MASK, hugePages * FRAME_4KIB_SIZE_BYTES);
+	const PageTableEntryFlags flags = *entry & (FLAGS_MASK | PageNoExecute);
+
+	// A 1 GiB page turns into 2 MiB ones, which are still huge, while a 2 MiB page turns into regular 4 KiB ones
+	const usz smallerPages = hugePages / PAGE_TABLE_ENTRIES;
+	const PageTableEntryFlags smallerFlags = smallerPages > 1 ? flags : flags & ~PageHugePage;
+
+	for (usz i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+		table[i] = (frame + (i * smallerPages * FRAME_4KIB_SIZE_BYTES)) | smallerFlags;
+	}
+
+	*entry = tableFrame | PagePresent | PageWriteable | (flags & PageUserAccessible);
+}
+
 Result Page4KiBMap(PageTableEntry* p4Table, Page4KiB page, Frame4KiB frame, PageTableEntryFlags flags)
 {
-	u16 p4Index = VirtAddrPage4Index(page);
-	PageTableEntryFlags userAccessible = flags & PageUserAccessible;
+	return PageMapRange(p4Table, page, 1, frame, flags);
+}
 
-	// If there is no Level 3 table at the expected level 4's index, we need to create it
-	if (!(p4Table[p4Index] & PagePresent)) {
-		Frame4KiB newP3 = AllocateFrame(&g_frameAllocator);
+Result Page4KiBUnmap(PageTableEntry* p4Table, Page4KiB page) { return PageUnmapRange(p4Table, page, 1, false, nullptr); }
 
-		// The newly created Level 3 table should be empty
-		MemoryFill(PhysAddrAsPointer(newP3), 0, FRAME_4KIB_SIZE_BYTES);
+Result Page4KiBRemap(PageTableEntry* p4Table, Page4KiB page, Frame4KiB frame, PageTableEntryFlags flags)
+{
+	PageWalk walk;
+	Result result = WalkToP1Table(p4Table, page, flags, false, &walk);
+	if (!result && walk.HugeEntry) {
+		// Only a part of the huge page changes, so the rest of it has to be kept as it is
+		SplitHugeEntry(walk.HugeEntry, walk.HugePages);
+		return Page4KiBRemap(p4Table, page, frame, flags);
+	}
 
-		p4Table[p4Index] = newP3 | PagePresent | PageWriteable;
+	// If there is no entry at the expected level 1's index, this virtual address is not mapped.
+	if (result || !(walk.P1Table[VirtAddrPage1Index(page)] & PagePresent)) {
+		LogLine(SK_LOG_WARN "An attempt was made to remap an unmapped page");
+		return ResultPageAlreadyUnmapped;
 	}
 
-	// If the entry pointing to the Level 3 table is not user accessible but it should be, we make it user accessible
-	p4Table[p4Index] |= userAccessible;
+	walk.P1Table[VirtAddrPage1Index(page)] = frame | LeafFlags(page, flags) | PagePresent;
+
+	return ResultOk;
+}
+
+/// Returns the level 2 table covering the given page, creating the tables above it if needed.
+static Result WalkToP2Table(PageTableEntry* p4Table, VirtAddr page, PageTableEntryFlags flags, PageTableEntry** p2Table)
+{
+	PageTableEntry* p3Table;
+	Result result = NextLevelTable(&p4Table[VirtAddrPage4Index(page)], flags, true, &p3Table);
+	if (result) {
+		return result;
+	}
 
-	u16 p3Index = VirtAddrPage3Index(page);
-	PageTableEntry* p3Table = PhysAddrAsPointer(p4Table[p4Index] & ~(0xfff));
+	PageTableEntry* p3Entry = &p3Table[VirtAddrPage3Index(page)];
+	if (IsHugeEntry(*p3Entry)) {
+		return ResultPageAlreadyMapped;
+	}
 
-	// If there is no Level 2 table at the expected level 3's index, we need to create it
-	if (!(p3Table[p3Index] & PagePresent)) {
-		Frame4KiB newP2 = AllocateFrame(&g_frameAllocator);
+	return NextLevelTable(p3Entry, flags, true, p2Table);
+}
 
-		// The newly created Level 2 table should be empty
-		MemoryFill(PhysAddrAsPointer(newP2), 0, FRAME_4KIB_SIZE_BYTES);
+Result Page2MiBMap(PageTableEntry* p4Table, Page2MiB page, Frame2MiB frame, PageTableEntryFlags flags)
+{
+	if (!Page2MiBIsAligned(page)) {
+		return ResultInvalidPageAlignment;
+	}
 
-		p3Table[p3Index] = newP2 | PagePresent | PageWriteable;
+	if (!Frame2MiBAlignCheck(frame)) {
+		return ResultInvalidFrameAlignment;
 	}
 
-	// If the entry pointing to the Level 2 table is not user accessible but it should be, we make it user accessible
-	p3Table[p3Index] |= userAccessible;
+	PageTableEntry* p2Table;
+	Result result = WalkToP2Table(p4Table, page, flags, &p2Table);
 
-	u16 p2Index = VirtAddrPage2Index(page);
-	PageTableEntry* p2Table = PhysAddrAsPointer(p3Table[p3Index] & ~(0xfff));
+	// Neither a 1 GiB page nor a level 1 table may already be there
+	if (result || (p2Table[VirtAddrPage2Index(page)] & PagePresent)) {
+		LogLine(SK_LOG_WARN "An attempt was made to map an existing page table entry");
+		return ResultPageAlreadyMapped;
+	}
 
-	// If there is no Level 1 table at the expected level 2's index, we need to create it
-	if (!(p2Table[p2Index] & PagePresent)) {
-		Frame4KiB newP1 = AllocateFrame(&g_frameAllocator);
+	p2Table[VirtAddrPage2Index(page)] = frame | LeafFlags(page, flags) | PageHugePage | PagePresent;
 
-		// The newly created Level 1 table should be empty
-		MemoryFill(PhysAddrAsPointer(newP1), 0, FRAME_4KIB_SIZE_BYTES);
+	return ResultOk;
+}
 
-		p2Table[p2Index] = newP1 | PagePresent | PageWriteable;
+Result Page1GiBMap(PageTableEntry* p4Table, Page1GiB page, Frame1GiB frame, PageTableEntryFlags flags)
+{
+	if (!Page1GiBIsAligned(page)) {
+		return ResultInvalidPageAlignment;
 	}
 
-	// If the entry pointing to the Level 1 table is not user accessible but it should be, we make it user accessible
-	p2Table[p2Index] |= userAccessible;
+	if (!Frame1GiBAlignCheck(frame)) {
+		return ResultInvalidFrameAlignment;
+	}
 
-	u16 p1Index = VirtAddrPage1Index(page);
-	PageTableEntry* p1Table = PhysAddrAsPointer(p2Table[p2Index] & ~(0xfff));
+	PageTableEntry* p3Table;
+	Result result = NextLevelTable(&p4Table[VirtAddrPage4Index(page)], flags, true, &p3Table);
+	if (result) {
+		return result;
+	}
 
-	// If we are trying to map an existing page, something went really wrong...
-	if (p1Table[p1Index] & PagePresent) {
+	if (p3Table[VirtAddrPage3Index(page)] & PagePresent) {
 		LogLine(SK_LOG_WARN "An attempt was made to map an existing page table entry");
 		return ResultPageAlreadyMapped;
 	}
 
-	p1Table[p1Index] = frame | flags | PagePresent;
+	p3Table[VirtAddrPage3Index(page)] = frame | LeafFlags(page, flags) | PageHugePage | PagePresent;
 
 	return ResultOk;
 }
 
-Result Page4KiBUnmap(const PageTableEntry* p4Table, Page4KiB page)
+/// Finds the entry of a huge page of the given size, which has to begin at exactly the given page.
+static Result FindHugeEntry(PageTableEntry* p4Table, VirtAddr page, usz hugePages, PageTableEntry** entry)
 {
-	u16 p4Index = VirtAddrPage4Index(page);
+	if (!__builtin_is_aligned(page, hugePages * PAGE_4KIB_SIZE_BYTES)) {
+		return ResultInvalidPageAlignment;
+	}
 
-	// If there is no Level 3 table at the expected level 4's index, this virtual address is not mapped.
-	if (!(p4Table[p4Index] & PagePresent)) {
-		LogLine(SK_LOG_WARN "An attempt was made to unmap an already unmapped page");
+	PageWalk walk;
+	Result result = WalkToP1Table(p4Table, page, 0, false, &walk);
+	if (result || walk.HugePages != hugePages) {
 		return ResultPageAlreadyUnmapped;
 	}
 
-	u16 p3Index = VirtAddrPage3Index(page);
-	PageTableEntry* p3Table = PhysAddrAsPointer(p4Table[p4Index] & ~(0xfff));
+	*entry = walk.HugeEntry;
+	return ResultOk;
+}
 
-	// If there is no Level 2 table at the expected level 3's index, this virtual address is not mapped.
-	if (!(p3Table[p3Index] & PagePresent)) {
+Result Page2MiBUnmap(PageTableEntry* p4Table, Page2MiB page)
+{
+	PageTableEntry* entry;
+	Result result = FindHugeEntry(p4Table, page, PAGE_2MIB_PAGES, &entry);
+	if (result) {
 		LogLine(SK_LOG_WARN "An attempt was made to unmap an already unmapped page");
-		return ResultPageAlreadyUnmapped;
+		return result;
 	}
 
-	u16 p2Index = VirtAddrPage2Index(page);
-	PageTableEntry* p2Table = PhysAddrAsPointer(p3Table[p3Index] & ~(0xfff));
+	*entry = 0;
+
+	return ResultOk;
+}
 
-	// If there is no Level 1 table at the expected level 2's index, this virtual address is not mapped.
-	if (!(p2Table[p2Index] & PagePresent)) {
+Result Page1GiBUnmap(PageTableEntry* p4Table, Page1GiB page)
+{
+	PageTableEntry* entry;
+	Result result = FindHugeEntry(p4Table, page, PAGE_1GIB_PAGES, &entry);
+	if (result) {
 		LogLine(SK_LOG_WARN "An attempt was made to unmap an already unmapped page");
-		return ResultPageAlreadyUnmapped;
+		return result;
 	}
 
-	u16 p1Index = VirtAddrPage1Index(page);
-	PageTableEntry* p1Table = PhysAddrAsPointer(p2Table[p2Index] & ~(0xfff));
+	*entry = 0;
 
-	// If there is no entry at the expected level 1's index, this virtual address is not mapped.
-	if (!(p1Table[p1Index] & PagePresent)) {
-		LogLine(SK_LOG_WARN "An attempt was made to unmap an already unmapped page");
-		return ResultPageAlreadyUnmapped;
+	return ResultOk;
+}
+
+Result Page2MiBSplit(PageTableEntry* p4Table, Page2MiB page)
+{
+	PageTableEntry* entry;
+	Result result = FindHugeEntry(p4Table, page, PAGE_2MIB_PAGES, &entry);
+	if (result) {
+		return result;
 	}
 
-	p1Table[p1Index] = 0;
+	SplitHugeEntry(entry, PAGE_2MIB_PAGES);
 
 	return ResultOk;
 }
 
-Result Page4KiBRemap(PageTableEntry* p4Table, Page4KiB page, Frame4KiB frame, PageTableEntryFlags flags)
+Result Page1GiBSplit(PageTableEntry* p4Table, Page1GiB page)
 {
-	u16 p4Index = VirtAddrPage4Index(page);
+	PageTableEntry* entry;
+	Result result = FindHugeEntry(p4Table, page, PAGE_1GIB_PAGES, &entry);
+	if (result) {
+		return result;
+	}
 
-	// If there is no Level 3 table at the expected level 4's index, this virtual address is not mapped.
-	if (!(p4Table[p4Index] & PagePresent)) {
-		LogLine(SK_LOG_WARN "An attempt was made to remap an unmapped page");
-		return ResultPageAlreadyUnmapped;
+	SplitHugeEntry(entry, PAGE_1GIB_PAGES);
+
+	return ResultOk;
+}
+
+/// Returns how many of the given number of pages, starting at the given one, are covered by the same level 1 table.
+static usz PagesInP1Table(Page4KiB page, usz count)
+{
+	const usz remaining = PAGE_TABLE_ENTRIES - VirtAddrPage1Index(page);
+	return count < remaining ? count : remaining;
+}
+
+/// Checks whether the given range covers the whole huge page the walk ended at,
+/// if not, the huge page gets split so the range's part of it can be changed on its own.
+static bool RangeCoversHugeEntry(const PageWalk* walk, Page4KiB page, usz count)
+{
+	if (__builtin_is_aligned(page, walk->HugePages * PAGE_4KIB_SIZE_BYTES) && count >= walk->HugePages) {
+		return true;
 	}
 
-	p4Table[p4Index] |= flags;
+	SplitHugeEntry(walk->HugeEntry, walk->HugePages);
+	return false;
+}
 
-	u16 p3Index = VirtAddrPage3Index(page);
-	PageTableEntry* p3Table = PhysAddrAsPointer(p4Table[p4Index] & ~(0xfff));
+/// Where the frames of a mapped range come from.
+typedef enum PageRangeBacking : u8 {
+	/// Consecutive frames, beginning at the given one.
+	PageRangeContiguous = 0,
+	/// Consecutive frames, mapped with 2 MiB pages wherever both the pages and the frames are aligned.
+	PageRangeContiguousHuge,
+	/// A freshly allocated frame for every page.
+	PageRangeAllocated,
+	/// A freshly allocated, zeroed frame for every page.
+	PageRangeZeroed,
+	/// No frames at all, the pages are only reserved until they're first accessed.
+	PageRangeLazy,
+} PageRangeBacking;
+
+static Result MapRange(PageTableEntry* p4Table, Page4KiB page, usz count, Frame4KiB frame, PageTableEntryFlags flags, PageRangeBacking backing)
+{
+	flags = LeafFlags(page, flags);
+
+	while (count > 0) {
+		// A whole level 1 table's worth of aligned pages can be covered by a single entry instead, unless there already is a table
+		if (backing == PageRangeContiguousHuge && count >= PAGE_2MIB_PAGES && Page2MiBIsAligned(page) && Frame2MiBAlignCheck(frame)) {
+			PageTableEntry* p2Table;
+			Result result = WalkToP2Table(p4Table, page, flags, &p2Table);
+			if (result) {
+				LogLine(SK_LOG_WARN "An attempt was made to map an existing page table entry");
+				return result;
+			}
+
+			PageTableEntry* p2Entry = &p2Table[VirtAddrPage2Index(page)];
+			if (!(*p2Entry & PagePresent)) {
+				*p2Entry = frame | flags | PageHugePage | PagePresent;
+
+				page += PAGE_2MIB_SIZE_BYTES;
+				frame += FRAME_2MIB_SIZE_BYTES;
+				count -= PAGE_2MIB_PAGES;
+				continue;
+			}
+		}
+
+		PageWalk walk;
+		Result result = WalkToP1Table(p4Table, page, flags, true, &walk);
+		if (result) {
+			return result;
+		}
+
+		if (walk.HugeEntry) {
+			LogLine(SK_LOG_WARN "An attempt was made to map an existing page table entry");
+			return ResultPageAlreadyMapped;
+		}
+
+		const usz pages = PagesInP1Table(page, count);
+		PageTableEntry* entry = &walk.P1Table[VirtAddrPage1Index(page)];
+
+		for (usz i = 0; i < pages; i++, entry++) {
+			// If we are trying to map an existing page, something went really wrong...
+			if (IsUsedEntry(*entry)) {
+				LogLine(SK_LOG_WARN "An attempt was made to map an existing page table entry");
+				return ResultPageAlreadyMapped;
+			}
+
+			if (backing == PageRangeLazy) {
+				*entry = flags | PageLazy;
+				continue;
+			}
+
+			if (backing == PageRangeAllocated) {
+				frame = AllocateFrame(&g_frameAllocator);
+			} else if (backing == PageRangeZeroed) {
+				frame = AllocateZeroedFrame(&g_frameAllocator);
+			}
+
+			*entry = frame | flags | PagePresent;
+
+			if (backing == PageRangeContiguous || backing == PageRangeContiguousHuge) {
+				frame += FRAME_4KIB_SIZE_BYTES;
+			}
+		}
+
+		page += pages * PAGE_4KIB_SIZE_BYTES;
+		count -= pages;
+	}
 
-	// If there is no Level 2 table at the expected level 3's index, this virtual address is not mapped.
-	if (!(p3Table[p3Index] & PagePresent)) {
-		LogLine(SK_LOG_WARN "An attempt was made to remap an unmapped page");
-		return ResultPageAlreadyUnmapped;
+	return ResultOk;
+}
+
+Result PageMapRange(PageTableEntry* p4Table, Page4KiB page, usz count, Frame4KiB frame, PageTableEntryFlags flags)
+{
+	return MapRange(p4Table, page, count, frame, flags, PageRangeContiguous);
+}
+
+Result PageMapRangeHuge(PageTableEntry* p4Table, Page4KiB page, usz count, Frame4KiB frame, PageTableEntryFlags flags)
+{
+	return MapRange(p4Table, page, count, frame, flags, PageRangeContiguousHuge);
+}
+
+Result PageMapRangeAllocated(PageTableEntry* p4Table, Page4KiB page, usz count, PageTableEntryFlags flags, bool zeroed)
+{
+	return MapRange(p4Table, page, count, 0, flags, zeroed ? PageRangeZeroed : PageRangeAllocated);
+}
+
+Result PageReserveRange(PageTableEntry* p4Table, Page4KiB page, usz count, PageTableEntryFlags flags)
+{
+	return MapRange(p4Table, page, count, 0, flags, PageRangeLazy);
+}
+
+Result PageBackReserved(PageTableEntry* p4Table, Page4KiB page)
+{
+	PageWalk walk;
+	Result result = WalkToP1Table(p4Table, page, 0, false, &walk);
+	if (result || walk.HugeEntry) {
+		return ResultNotFound;
 	}
 
-	p3Table[p3Index] |= flags;
+	PageTableEntry* entry = &walk.P1Table[VirtAddrPage1Index(page)];
+	if (!(*entry & PageLazy)) {
+		return ResultNotFound;
+	}
 
-	u16 p2Index = VirtAddrPage2Index(page);
-	PageTableEntry* p2Table = PhysAddrAsPointer(p3Table[p3Index] & ~(0xfff));
+	// Not present entries are never cached, so there is nothing to invalidate
+	*entry = AllocateZeroedFrame(&g_frameAllocator) | (*entry & ~PageLazy) | PagePresent;
 
-	// If there is no Level 1 table at the expected level 2's index, this virtual address is not mapped.
-	if (!(p2Table[p2Index] & PagePresent)) {
-		LogLine(SK_LOG_WARN "An attempt was made to remap an unmapped page");
-		return ResultPageAlreadyUnmapped;
+	return ResultOk;
+}
+
+Result PageUnmapRange(PageTableEntry* p4Table, Page4KiB page, usz count, bool deallocateFrames, TLBGather* gather)
+{
+	while (count > 0) {
+		PageWalk walk;
+		Result result = WalkToP1Table(p4Table, page, 0, false, &walk);
+		if (result) {
+			LogLine(SK_LOG_WARN "An attempt was made to unmap an already unmapped page");
+			return result;
+		}
+
+		if (walk.HugeEntry) {
+			if (!RangeCoversHugeEntry(&walk, page, count)) {
+				continue;
+			}
+
+			if (deallocateFrames) {
+				DeallocateContiguousFrames(&g_frameAllocator, *walk.HugeEntry & FRAME_ADDRESS_MASK, walk.HugePages);
+			}
+
+			*walk.HugeEntry = 0;
+			ReleaseEmptyTables(p4Table, &walk, page);
+
+			if (gather) {
+				TLBGatherPage(gather, page);
+			}
+
+			page += walk.HugePages * PAGE_4KIB_SIZE_BYTES;
+			count -= walk.HugePages;
+			continue;
+		}
+
+		const usz pages = PagesInP1Table(page, count);
+		PageTableEntry* entry = &walk.P1Table[VirtAddrPage1Index(page)];
+
+		for (usz i = 0; i < pages; i++, entry++) {
+			// A reserved page that was never accessed has neither a frame nor a TLB entry
+			if (*entry & PageLazy) {
+				*entry = 0;
+				continue;
+			}
+
+			if (!(*entry & PagePresent)) {
+				LogLine(SK_LOG_WARN "An attempt was made to unmap an already unmapped page");
+				return ResultPageAlreadyUnmapped;
+			}
+
+			// Frames shared with other address spaces only lose this one's reference
+			if (deallocateFrames && !(*entry & PageBorrowed)) {
+				FramePut(*entry & FRAME_ADDRESS_MASK);
+			}
+
+			*entry = 0;
+
+			if (gather) {
+				TLBGatherPage(gather, page + (i * PAGE_4KIB_SIZE_BYTES));
+			}
+		}
+
+		ReleaseEmptyTables(p4Table, &walk, page);
+
+		page += pages * PAGE_4KIB_SIZE_BYTES;
+		count -= pages;
 	}
 
-	p2Table[p2Index] |= flags;
+	return ResultOk;
+}
 
-	u16 p1Index = VirtAddrPage1Index(page);
-	PageTableEntry* p1Table = PhysAddrAsPointer(p2Table[p2Index] & ~(0xfff));
+Result PageProtectRange(PageTableEntry* p4Table, Page4KiB page, usz count, PageTableEntryFlags flags, TLBGather* gather)
+{
+	flags = LeafFlags(page, flags);
+
+	while (count > 0) {
+		PageWalk walk;
+		Result result = WalkToP1Table(p4Table, page, flags, false, &walk);
+		if (result) {
+			LogLine(SK_LOG_WARN "An attempt was made to remap an unmapped page");
+			return result;
+		}
+
+		if (walk.HugeEntry) {
+			if (!RangeCoversHugeEntry(&walk, page, count)) {
+				continue;
+			}
+
+			*walk.HugeEntry = (*walk.HugeEntry & FRAME_ADDRESS_MASK) | flags | PageHugePage | PagePresent;
+
+			if (gather) {
+				TLBGatherPage(gather, page);
+			}
+
+			page += walk.HugePages * PAGE_4KIB_SIZE_BYTES;
+			count -= walk.HugePages;
+			continue;
+		}
+
+		const usz pages = PagesInP1Table(page, count);
+		PageTableEntry* entry = &walk.P1Table[VirtAddrPage1Index(page)];
+
+		for (usz i = 0; i < pages; i++, entry++) {
+			if (*entry & PageLazy) {
+				*entry = flags | PageLazy;
+				continue;
+			}
+
+			if (!(*entry & PagePresent)) {
+				LogLine(SK_LOG_WARN "An attempt was made to remap an unmapped page");
+				return ResultPageAlreadyUnmapped;
+			}
+
+			// A shared frame must not become writeable before it gets copied
+			const PageTableEntry kept = *entry & (FRAME_ADDRESS_MASK | PageBorrowed | PageSharedMemory);
+			if ((flags & PageWriteable) && IsSharedFrame(page + (i * PAGE_4KIB_SIZE_BYTES), *entry)) {
+				*entry = kept | (flags & ~PageWriteable) | PageCopyOnWrite | PagePresent;
+			} else {
+				*entry = kept | flags | PagePresent;
+			}
+
+			if (gather) {
+				TLBGatherPage(gather, page + (i * PAGE_4KIB_SIZE_BYTES));
+			}
+		}
+
+		page += pages * PAGE_4KIB_SIZE_BYTES;
+		count -= pages;
+	}
 
-	// If there is no entry at the expected level 1's index, this virtual address is not mapped.
-	if (!(p1Table[p1Index] & PagePresent)) {
-		LogLine(SK_LOG_WARN "An attempt was made to remap an unmapped page");
-		return ResultPageAlreadyUnmapped;
+	return ResultOk;
+}
+
+/// Consecutive frames left without any references during a teardown, given back to the frame allocator together.
+typedef struct FrameRun {
+	Frame4KiB Begin;
+	usz Count;
+} FrameRun;
+
+static void FrameRunRelease(FrameRun* run)
+{
+	if (run->Count == 1) {
+		DeallocateFrame(&g_frameAllocator, run->Begin);
+	} else if (run->Count > 1) {
+		DeallocateContiguousFrames(&g_frameAllocator, run->Begin, run->Count);
+	}
+
+	run->Count = 0;
+}
+
+static void FrameRunAdd(FrameRun* run, Frame4KiB frame, usz count)
+{
+	if (run->Count > 0 && frame == run->Begin + (run->Count * FRAME_4KIB_SIZE_BYTES)) {
+		run->Count += count;
+		return;
+	}
+
+	FrameRunRelease(run);
+
+	run->Begin = frame;
+	run->Count = count;
+}
+
+/// Drops the references to every frame mapped below the given table, deallocating the tables under it on the way back up.
+static void ReleaseTableTree(PageTableEntry* table, usz level, FrameRun* run)
+{
+	for (usz i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+		const PageTableEntry entry = table[i];
+		if (!(entry & PagePresent)) {
+			continue;
+		}
+
+		const Frame4KiB frame = entry & FRAME_ADDRESS_MASK;
+
+		if (level == 1) {
+			if (entry & PageBorrowed) {
+				continue;
+			}
+
+			// Frames referenced from somewhere else as well only lose this address space's reference
+			if (FrameInfoOf(frame)->ReferenceCount != 1) {
+				FramePut(frame);
+			} else {
+				FrameRunAdd(run, frame, 1);
+			}
+
+			continue;
+		}
+
+		if (entry & PageHugePage) {
+			const usz hugePages = level == 2 ? PAGE_2MIB_PAGES : PAGE_1GIB_PAGES;
+			FrameRunAdd(run, __builtin_align_down(frame, hugePages * FRAME_4KIB_SIZE_BYTES), hugePages);
+			continue;
+		}
+
+		ReleaseTableTree(PhysAddrAsPointer(frame), level - 1, run);
+		DeallocateFrame(&g_frameAllocator, frame);
+	}
+}
+
+void PageReleaseUserHalf(PageTableEntry* p4Table)
+{
+	FrameRun run = {};
+
+	for (usz i = 0; i < PAGE_TABLE_ENTRIES / 2; i++) {
+		if (!(p4Table[i] & PagePresent)) {
+			continue;
+		}
+
+		const Frame4KiB p3Table = p4Table[i] & FRAME_ADDRESS_MASK;
+
+		ReleaseTableTree(PhysAddrAsPointer(p3Table), 3, &run);
+		DeallocateFrame(&g_frameAllocator, p3Table);
+
+		p4Table[i] = 0;
+	}
+
+	FrameRunRelease(&run);
+}
+
+/// Copies the given table's subtree into the destination one, sharing every user page's frame copy-on-write, apart from shared memory.
+/// Supervisor pages in the user half are the kernel's per-thread state, e.g. kernel stacks, so they're left out.
+static void ShareTableTree(PageTableEntry* source, PageTableEntry* destination, VirtAddr base, usz level, TLBGather* gather)
+{
+	const usz entrySize = PAGE_4KIB_SIZE_BYTES << (9 * (level - 1));
+	const usz entries = level == 4 ? PAGE_TABLE_ENTRIES / 2 : PAGE_TABLE_ENTRIES;
+
+	for (usz i = 0; i < entries; i++) {
+		PageTableEntry* entry = &source[i];
+		if (!IsUsedEntry(*entry) || !(*entry & PageUserAccessible)) {
+			continue;
+		}
+
+		const VirtAddr page = base + (i * entrySize);
+
+		if (level == 1) {
+			// Reserved pages just stay reserved in both address spaces, and borrowed frames aren't reference counted
+			if (*entry & PagePresent) {
+				const Frame4KiB frame = *entry & FRAME_ADDRESS_MASK;
+
+				if ((*entry & PageWriteable) && !(*entry & PageSharedMemory)) {
+					*entry = (*entry & ~PageWriteable) | PageCopyOnWrite;
+					TLBGatherPage(gather, page);
+				}
+
+				if (!(*entry & PageBorrowed)) {
+					FrameGet(frame);
+					FrameInfoOf(frame)->Flags |= FrameInfoShared | ((*entry & PageCopyOnWrite) ? FrameInfoCopyOnWrite : 0);
+				}
+			}
+
+			destination[i] = *entry;
+			continue;
+		}
+
+		// Sharing happens a 4 KiB page at a time, so only the written to pages have to be copied
+		if (*entry & PageHugePage) {
+			SplitHugeEntry(entry, entrySize / PAGE_4KIB_SIZE_BYTES);
+		}
+
+		const Frame4KiB table = AllocatePageTable();
+		destination[i] = table | (*entry & FLAGS_MASK);
+
+		ShareTableTree(PhysAddrAsPointer(*entry & FRAME_ADDRESS_MASK), PhysAddrAsPointer(table), page, level - 1, gather);
+	}
+}
+
+void PageShareUserHalf(PageTableEntry* sourceP4Table, PageTableEntry* destinationP4Table, TLBGather* gather)
+{
+	ShareTableTree(sourceP4Table, destinationP4Table, 0, 4, gather);
+}
+
+Result PageCopyShared(PageTableEntry* p4Table, Page4KiB page)
+{
+	PageWalk walk;
+	Result result = WalkToP1Table(p4Table, page, 0, false, &walk);
+	if (result || walk.HugeEntry) {
+		return ResultNotFound;
+	}
+
+	PageTableEntry* entry = &walk.P1Table[VirtAddrPage1Index(page)];
+	if (!(*entry & PagePresent) || !(*entry & PageCopyOnWrite)) {
+		return ResultNotFound;
+	}
+
+	const Frame4KiB frame = *entry & FRAME_ADDRESS_MASK;
+	const PageTableEntryFlags flags = (*entry & ~(FRAME_ADDRESS_MASK | PageCopyOnWrite | PageBorrowed)) | PageWriteable;
+	const bool borrowed = *entry & PageBorrowed;
+
+	// Once every other address space has copied the frame, the last one can simply take it over
+	if (!borrowed && FrameInfoOf(frame)->ReferenceCount == 1) {
+		FrameInfoOf(frame)->Flags &= ~(FrameInfoShared | FrameInfoCopyOnWrite);
+		*entry = frame | flags;
+		return ResultOk;
+	}
+
+	const Frame4KiB copy = AllocateFrame(&g_frameAllocator);
+	MemoryCopy(PhysAddrAsPointer(frame), PhysAddrAsPointer(copy), PAGE_4KIB_SIZE_BYTES);
+
+	if (!borrowed) {
+		FramePut(frame);
 	}
 
-	p1Table[p1Index] = frame | flags | PagePresent;
+	*entry = copy | flags;
 
 	return ResultOk;
 }
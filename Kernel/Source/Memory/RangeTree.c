@@ -0,0 +1,206 @@
+#include "Memory/RangeTree.h"
+
+static usz NodeHeight(const RangeTreeNode* node) { return node ? node->Height : 0; }
+
+static void NodeUpdate(const RangeTree* tree, RangeTreeNode* node)
+{
+	const usz leftHeight = NodeHeight(node->Left);
+	const usz rightHeight = NodeHeight(node->Right);
+
+	node->Height = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+
+	if (tree->Update) {
+		tree->Update(node);
+	}
+}
+
+static RangeTreeNode* NodeRotateLeft(const RangeTree* tree, RangeTreeNode* node)
+{
+	RangeTreeNode* right = node->Right;
+	node->Right = right->Left;
+	right->Left = node;
+
+	NodeUpdate(tree, node);
+	NodeUpdate(tree, right);
+
+	return right;
+}
+
+static RangeTreeNode* NodeRotateRight(const RangeTree* tree, RangeTreeNode* node)
+{
+	RangeTreeNode* left = node->Left;
+	node->Left = left->Right;
+	left->Right = node;
+
+	NodeUpdate(tree, node);
+	NodeUpdate(tree, left);
+
+	return left;
+}
+
+/// Updates the node after one of its subtrees changed and rotates it back into balance, returning the subtree's new root.
+static RangeTreeNode* NodeBalance(const RangeTree* tree, RangeTreeNode* node)
+{
+	NodeUpdate(tree, node);
+
+	const usz leftHeight = NodeHeight(node->Left);
+	const usz rightHeight = NodeHeight(node->Right);
+
+	if (leftHeight > rightHeight + 1) {
+		if (NodeHeight(node->Left->Right) > NodeHeight(node->Left->Left)) {
+			node->Left = NodeRotateLeft(tree, node->Left);
+		}
+
+		return NodeRotateRight(tree, node);
+	}
+
+	if (rightHeight > leftHeight + 1) {
+		if (NodeHeight(node->Right->Left) > NodeHeight(node->Right->Right)) {
+			node->Right = NodeRotateRight(tree, node->Right);
+		}
+
+		return NodeRotateLeft(tree, node);
+	}
+
+	return node;
+}
+
+static RangeTreeNode* NodeInsert(const RangeTree* tree, RangeTreeNode* root, RangeTreeNode* node)
+{
+	if (!root) {
+		return node;
+	}
+
+	if (node->Begin < root->Begin) {
+		root->Left = NodeInsert(tree, root->Left, node);
+	} else {
+		root->Right = NodeInsert(tree, root->Right, node);
+	}
+
+	return NodeBalance(tree, root);
+}
+
+/// Unlinks the lowest node of the subtree, returning it through `lowest` and the subtree's new root as the return value.
+static RangeTreeNode* NodeUnlinkLowest(const RangeTree* tree, RangeTreeNode* root, RangeTreeNode** lowest)
+{
+	if (!root->Left) {
+		*lowest = root;
+		return root->Right;
+	}
+
+	root->Left = NodeUnlinkLowest(tree, root->Left, lowest);
+	return NodeBalance(tree, root);
+}
+
+/// Unlinks the node beginning at the given address, returning it through `removed` and the subtree's new root as the return value.
+static RangeTreeNode* NodeUnlink(const RangeTree* tree, RangeTreeNode* root, u64 begin, RangeTreeNode** removed)
+{
+	if (!root) {
+		return nullptr;
+	}
+
+	if (begin < root->Begin) {
+		root->Left = NodeUnlink(tree, root->Left, begin, removed);
+		return NodeBalance(tree, root);
+	}
+
+	if (begin > root->Begin) {
+		root->Right = NodeUnlink(tree, root->Right, begin, removed);
+		return NodeBalance(tree, root);
+	}
+
+	*removed = root;
+
+	if (!root->Left || !root->Right) {
+		return root->Left ? root->Left : root->Right;
+	}
+
+	// The next node up takes the removed one's place
+	RangeTreeNode* successor;
+	RangeTreeNode* right = NodeUnlinkLowest(tree, root->Right, &successor);
+	successor->Left = root->Left;
+	successor->Right = right;
+
+	return NodeBalance(tree, successor);
+}
+
+static Result NodeWalk(const RangeTreeNode* node, RangeTreeWalkFunction function, void* context)
+{
+	if (!node) {
+		return ResultOk;
+	}
+
+	Result result = NodeWalk(node->Left, function, context);
+	if (result) {
+		return result;
+	}
+
+	result = function(node, context);
+	if (result) {
+		return result;
+	}
+
+	return NodeWalk(node->Right, function, context);
+}
+
+void InitRangeTree(RangeTree* tree, RangeTreeUpdateFunction update)
+{
+	tree->Root = nullptr;
+	tree->Update = update;
+}
+
+void RangeTreeInsert(RangeTree* tree, RangeTreeNode* node)
+{
+	node->Left = nullptr;
+	node->Right = nullptr;
+	NodeUpdate(tree, node);
+
+	tree->Root = NodeInsert(tree, tree->Root, node);
+}
+
+RangeTreeNode* RangeTreeRemove(RangeTree* tree, u64 begin)
+{
+	RangeTreeNode* removed = nullptr;
+	tree->Root = NodeUnlink(tree, tree->Root, begin, &removed);
+
+	return removed;
+}
+
+RangeTreeNode* RangeTreeFloor(const RangeTree* tree, u64 address)
+{
+	RangeTreeNode* node = tree->Root;
+	RangeTreeNode* floor = nullptr;
+
+	while (node) {
+		if (node->Begin <= address) {
+			floor = node;
+			node = node->Right;
+		} else {
+			node = node->Left;
+		}
+	}
+
+	return floor;
+}
+
+RangeTreeNode* RangeTreeCeiling(const RangeTree* tree, u64 address)
+{
+	RangeTreeNode* node = tree->Root;
+	RangeTreeNode* ceiling = nullptr;
+
+	while (node) {
+		if (node->Begin > address) {
+			ceiling = node;
+			node = node->Left;
+		} else {
+			node = node->Right;
+		}
+	}
+
+	return ceiling;
+}
+
+Result RangeTreeWalk(const RangeTree* tree, RangeTreeWalkFunction function, void* context)
+{
+	return NodeWalk(tree->Root, function, context);
+}
@@ -0,0 +1,245 @@
+#include "Memory/SharedMemory.h"
+
+#include "Memory.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/FrameInfo.h"
+#include "Memory/Heap.h"
+#include "Memory/VirtualMemoryAllocator.h"
+#include "Scheduler.h"
+
+SharedMemory g_sharedMemory;
+
+Result InitSharedMemory(SharedMemory* sharedMemory)
+{
+	usz objectPoolSize = Page4KiBNext(SizedBlockPoolSizeBytes(sizeof(SharedMemoryObject), MAX_SHARED_MEMORY_OBJECTS));
+	void* objectPool;
+	Result result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, objectPoolSize, PageWriteable, &objectPool);
+	if (result) {
+		return result;
+	}
+
+	result = InitSizedBlockAllocator(&sharedMemory->Objects, objectPool, objectPoolSize, sizeof(SharedMemoryObject));
+	if (result) {
+		return result;
+	}
+
+	return result;
+}
+
+static SharedMemoryObject* SharedMemoryFind(const i8* name, usz nameSize)
+{
+	SharedMemoryObject* objectIter = nullptr;
+	while (!SizedBlockIterate(&g_sharedMemory.Objects, (void**)&objectIter)) {
+		// Comparing the null terminator as well, so a name doesn't match the ones it's a prefix of
+		if (MemoryCompare(objectIter->Name, name, nameSize + 1)) {
+			return objectIter;
+		}
+	}
+
+	return nullptr;
+}
+
+static Result SharedMemoryCreate(const i8* name, usz nameSize, usz sizeBytes, SharedMemoryObject** createdObject)
+{
+	SharedMemoryObject* object;
+	Result result = SizedBlockAllocate(&g_sharedMemory.Objects, (void**)&object);
+	if (result) {
+		return result;
+	}
+
+	const usz pageCount = sizeBytes / PAGE_4KIB_SIZE_BYTES;
+	void* frames;
+	result = HeapAllocate(&g_kernelHeap, pageCount * sizeof(Frame4KiB), &frames);
+	if (result) {
+		SizedBlockDeallocate(&g_sharedMemory.Objects, object);
+		return result;
+	}
+
+	MemoryFill(object->Name, 0, SHARED_MEMORY_NAME_SIZE);
+	MemoryCopy(name, object->Name, nameSize);
+	object->References = 0;
+	object->PageCount = pageCount;
+	object->Frames = frames;
+
+	// Running out of memory here is the caller's problem, not a reason to panic, so the frames come from the engine directly
+	const FrameTag previousTag = FrameAllocatorSetTag(&g_frameAllocator, FrameTagSharedMemory);
+	for (usz i = 0; i < pageCount; i++) {
+		Frame4KiB frame;
+		result = AllocateFrameInZone(&g_frameAllocator, FrameZoneNormal, &frame);
+		if (result) {
+			for (usz j = 0; j < i; j++) {
+				FramePut(object->Frames[j]);
+			}
+
+			FrameAllocatorSetTag(&g_frameAllocator, previousTag);
+			HeapDeallocate(&g_kernelHeap, frames, pageCount * sizeof(Frame4KiB));
+			SizedBlockDeallocate(&g_sharedMemory.Objects, object);
+			return result;
+		}
+
+		MemoryFill(PhysAddrAsPointer(frame), 0, FRAME_4KIB_SIZE_BYTES);
+
+		FrameInfo* info = FrameInfoOf(frame);
+		info->Flags |= FrameInfoShared;
+		info->Owner = object;
+		info->Index = i;
+
+		object->Frames[i] = frame;
+	}
+	FrameAllocatorSetTag(&g_frameAllocator, previousTag);
+
+	*createdObject = object;
+
+	return result;
+}
+
+/// Drops a reference to the object, destroying it once no references are left.
+/// Frames still mapped somewhere stay alive until they get unmapped, only the object's own references are put.
+static void SharedMemoryPut(SharedMemoryObject* object)
+{
+	if (--object->References > 0) {
+		return;
+	}
+
+	for (usz i = 0; i < object->PageCount; i++) {
+		FramePut(object->Frames[i]);
+	}
+
+	HeapDeallocate(&g_kernelHeap, object->Frames, object->PageCount * sizeof(Frame4KiB));
+	SizedBlockDeallocate(&g_sharedMemory.Objects, object);
+}
+
+Result SharedMemoryMap(Process* process, const i8* name, usz sizeBytes, PageTableEntryFlags flags, void** mapping)
+{
+	const usz nameSize = StringSize(name);
+	if (nameSize == 0 || nameSize >= SHARED_MEMORY_NAME_SIZE) {
+		return ResultInvalidPath;
+	}
+
+	if (!Page4KiBIsAligned(sizeBytes)) {
+		return ResultInvalidPageAlignment;
+	}
+
+	SharedMemoryObject* object = SharedMemoryFind(name, nameSize);
+	if (object && sizeBytes != 0 && sizeBytes != object->PageCount * PAGE_4KIB_SIZE_BYTES) {
+		return ResultOutOfRange;
+	}
+
+	if (!object && sizeBytes == 0) {
+		return ResultNotFound;
+	}
+
+	SharedMemoryMapping* processMapping;
+	Result result = SizedBlockAllocate(&process->SharedMemoryMappings, (void**)&processMapping);
+	if (result) {
+		return result;
+	}
+
+	if (!object) {
+		result = SharedMemoryCreate(name, nameSize, sizeBytes, &object);
+		if (result) {
+			SizedBlockDeallocate(&process->SharedMemoryMappings, processMapping);
+			return result;
+		}
+	}
+
+	object->References++;
+
+	const usz mappingSize = object->PageCount * PAGE_4KIB_SIZE_BYTES;
+	Page4KiB mappingBegin;
+	result = AllocateVirtualRegion(&process->VirtualMemoryAllocator, mappingSize, &mappingBegin);
+	if (result) {
+		SizedBlockDeallocate(&process->SharedMemoryMappings, processMapping);
+		SharedMemoryPut(object);
+		return result;
+	}
+
+	// The entries are marked, so they stay writeable when the process gets copied or changes the mapping's protection
+	PageTableEntry* pml4 = PhysAddrAsPointer(process->PML4);
+	const PageTableEntryFlags pageFlags = flags | PageUserAccessible | PageSharedMemory;
+	for (usz i = 0; i < object->PageCount; i++) {
+		FrameGet(object->Frames[i]);
+
+		result = Page4KiBMap(pml4, mappingBegin + (i * PAGE_4KIB_SIZE_BYTES), object->Frames[i], pageFlags);
+		if (result) {
+			FramePut(object->Frames[i]);
+			PageUnmapRange(pml4, mappingBegin, i, true, nullptr);
+			MarkVirtualMemoryUnused(&process->VirtualMemoryAllocator, mappingBegin, mappingBegin + mappingSize);
+			SizedBlockDeallocate(&process->SharedMemoryMappings, processMapping);
+			SharedMemoryPut(object);
+			return result;
+		}
+	}
+
+	result = MappedRegionAdd(&process->MappedRegions, mappingBegin, mappingBegin + mappingSize, pageFlags, MappedRegionShared);
+	if (result) {
+		PageUnmapRange(pml4, mappingBegin, object->PageCount, true, nullptr);
+		MarkVirtualMemoryUnused(&process->VirtualMemoryAllocator, mappingBegin, mappingBegin + mappingSize);
+		SizedBlockDeallocate(&process->SharedMemoryMappings, processMapping);
+		SharedMemoryPut(object);
+		return result;
+	}
+
+	processMapping->Object = object;
+	processMapping->Begin = mappingBegin;
+
+	*mapping = (void*)mappingBegin;
+
+	return result;
+}
+
+Result SharedMemoryUnmap(Process* process, void* mapping)
+{
+	SharedMemoryMapping* mappingIter = nullptr;
+	while (!SizedBlockIterate(&process->SharedMemoryMappings, (void**)&mappingIter)) {
+		if (mappingIter->Begin != (Page4KiB)mapping) {
+			continue;
+		}
+
+		SharedMemoryObject* object = mappingIter->Object;
+
+		// Puts the mapping's references to the frames, the object's own ones keep them alive
+		Result result = DeallocateBackedVirtualMemory(&process->VirtualMemoryAllocator, mapping, object->PageCount * PAGE_4KIB_SIZE_BYTES);
+		if (result) {
+			return result;
+		}
+
+		result = MappedRegionRemove(&process->MappedRegions, mappingIter->Begin);
+		if (result) {
+			return result;
+		}
+
+		SizedBlockDeallocate(&process->SharedMemoryMappings, mappingIter);
+		SharedMemoryPut(object);
+
+		return result;
+	}
+
+	return ResultNotFound;
+}
+
+Result SharedMemoryCopyMappings(Process* destination, Process* source)
+{
+	SharedMemoryMapping* mappingIter = nullptr;
+	while (!SizedBlockIterate(&source->SharedMemoryMappings, (void**)&mappingIter)) {
+		SharedMemoryMapping* mapping;
+		Result result = SizedBlockAllocate(&destination->SharedMemoryMappings, (void**)&mapping);
+		if (result) {
+			return result;
+		}
+
+		*mapping = *mappingIter;
+		mapping->Object->References++;
+	}
+
+	return ResultOk;
+}
+
+void SharedMemoryReleaseMappings(Process* process)
+{
+	SharedMemoryMapping* mappingIter = nullptr;
+	while (!SizedBlockIterate(&process->SharedMemoryMappings, (void**)&mappingIter)) {
+		SharedMemoryPut(mappingIter->Object);
+		SizedBlockDeallocate(&process->SharedMemoryMappings, mappingIter);
+	}
+}
@@ -3,6 +3,68 @@
 #include "Logger.h"
 #include "Memory.h"
 
+static usz SizedBlockBitmapWordCount(const SizedBlockAllocator* blockAllocator) { return (blockAllocator->AllocationCapacity + 63) / 64; }
+
+static usz SizedBlockSummaryWordCount(const SizedBlockAllocator* blockAllocator)
+{
+	return (SizedBlockBitmapWordCount(blockAllocator) + 63) / 64;
+}
+
+/// Returns the bits of the bitmap word that stand for actual blocks, only the last word can have fewer than 64 of them.
+static u64 SizedBlockWordMask(const SizedBlockAllocator* blockAllocator, usz mapIndex)
+{
+	const usz blocksLeft = blockAllocator->AllocationCapacity - (mapIndex * 64);
+	if (blocksLeft >= 64) {
+		return U64_MAX;
+	}
+
+	return (1ULL << blocksLeft) - 1;
+}
+
+/// Returns the index of the first set bit at or after the given one, or `bitCount` if there's none.
+static usz FindSetBit(const u64* words, usz bitCount, usz from)
+{
+	if (from >= bitCount) {
+		return bitCount;
+	}
+
+	usz wordIndex = from / 64;
+	u64 word = words[wordIndex] & (U64_MAX << (from % 64));
+	const usz wordCount = (bitCount + 63) / 64;
+
+	while (!word) {
+		if (++wordIndex >= wordCount) {
+			return bitCount;
+		}
+
+		word = words[wordIndex];
+	}
+
+	return (wordIndex * 64) + __builtin_ctzll(word);
+}
+
+/// Returns the index of the first used block at or after the given one, or the allocator's capacity if there's none.
+/// Only the bitmap words marked in the summary are looked at, so the cost depends on the used blocks and not the capacity.
+static usz SizedBlockFindUsed(const SizedBlockAllocator* blockAllocator, usz from)
+{
+	if (from >= blockAllocator->AllocationCapacity) {
+		return blockAllocator->AllocationCapacity;
+	}
+
+	const usz mapIndex = from / 64;
+	const u64 word = blockAllocator->BlockBitmap[mapIndex] & (U64_MAX << (from % 64));
+	if (word) {
+		return (mapIndex * 64) + __builtin_ctzll(word);
+	}
+
+	const usz nextMapIndex = FindSetBit(blockAllocator->NonEmptyWords, SizedBlockBitmapWordCount(blockAllocator), mapIndex + 1);
+	if (nextMapIndex >= SizedBlockBitmapWordCount(blockAllocator)) {
+		return blockAllocator->AllocationCapacity;
+	}
+
+	return (nextMapIndex * 64) + __builtin_ctzll(blockAllocator->BlockBitmap[nextMapIndex]);
+}
+
 static void SizedBlockSetStatus(SizedBlockAllocator* blockAllocator, usz index, bool used)
 {
 	if (index >= blockAllocator->AllocationCapacity) {
@@ -11,11 +73,23 @@ static void SizedBlockSetStatus(SizedBlockAllocator* blockAllocator, usz index,
 
 	const usz mapIndex = index / 64;
 	const usz bitIndex = index % 64;
+	const usz summaryIndex = mapIndex / 64;
+	const u64 summaryBit = 1ULL << (mapIndex % 64);
 
 	if (used) {
-		blockAllocator->BlockBitmap[mapIndex] |= (1 << bitIndex);
+		blockAllocator->BlockBitmap[mapIndex] |= 1ULL << bitIndex;
+
+		blockAllocator->NonEmptyWords[summaryIndex] |= summaryBit;
+		if (blockAllocator->BlockBitmap[mapIndex] == SizedBlockWordMask(blockAllocator, mapIndex)) {
+			blockAllocator->NonFullWords[summaryIndex] &= ~summaryBit;
+		}
 	} else {
-		blockAllocator->BlockBitmap[mapIndex] &= ~(1 << bitIndex);
+		blockAllocator->BlockBitmap[mapIndex] &= ~(1ULL << bitIndex);
+
+		blockAllocator->NonFullWords[summaryIndex] |= summaryBit;
+		if (!blockAllocator->BlockBitmap[mapIndex]) {
+			blockAllocator->NonEmptyWords[summaryIndex] &= ~summaryBit;
+		}
 	}
 }
 
@@ -33,48 +107,70 @@ bool SizedBlockGetStatus(SizedBlockAllocator* blockAllocator, usz index)
 
 Result InitSizedBlockAllocator(SizedBlockAllocator* blockAllocator, void* poolStart, usz poolSizeBytes, usz blockSizeBytes)
 {
-	// TODO: Use more efficient bitscanning (compiler intrinsics)
 	blockAllocator->BlockSizeBytes = blockSizeBytes;
 	blockAllocator->PoolSizeBytes = poolSizeBytes;
 
+	// The metadata shrinks along with the capacity, so starting from the capacity it would leave if it was sized for the whole pool
+	// and then taking as many more blocks as still fit
 	const usz totalBlockCapacity = poolSizeBytes / blockSizeBytes;
-	const usz bitmapWordCount = (totalBlockCapacity + 63) / 64;
-	const usz blocksTakenUp = (bitmapWordCount * 8 + blockSizeBytes - 1) / blockSizeBytes;
+	const usz metadataBlocksUpperBound = (SizedBlockMetadataSizeBytes(totalBlockCapacity) + blockSizeBytes - 1) / blockSizeBytes;
+	if (totalBlockCapacity <= metadataBlocksUpperBound) {
+		return ResultOutOfRange;
+	}
+
+	usz capacity = totalBlockCapacity - metadataBlocksUpperBound;
+	while (SizedBlockPoolSizeBytes(blockSizeBytes, capacity + 1) <= poolSizeBytes) {
+		capacity++;
+	}
+
+	blockAllocator->AllocationCapacity = capacity;
+	blockAllocator->AllocationCount = 0;
+
+	const usz bitmapWordCount = SizedBlockBitmapWordCount(blockAllocator);
+	const usz summaryWordCount = SizedBlockSummaryWordCount(blockAllocator);
 
 	blockAllocator->BlockBitmap = poolStart;
+	blockAllocator->NonFullWords = blockAllocator->BlockBitmap + bitmapWordCount;
+	blockAllocator->NonEmptyWords = blockAllocator->NonFullWords + summaryWordCount;
 	// The allocator expects the blocks to be correctly padded for alignment,
 	// if they're not, some bad things are probably gonna happen
-	blockAllocator->FirstBlock = (u8*)poolStart + blocksTakenUp * blockSizeBytes;
-	blockAllocator->LastBlock = (u8*)poolStart + poolSizeBytes - blockSizeBytes;
-	blockAllocator->AllocationCapacity = totalBlockCapacity - blocksTakenUp;
-	blockAllocator->AllocationCount = 0;
-	blockAllocator->NextToAllocate = 0;
+	blockAllocator->FirstBlock = (u8*)poolStart + (SizedBlockPoolSizeBytes(blockSizeBytes, capacity) - (capacity * blockSizeBytes));
+
+	MemoryFill(blockAllocator->BlockBitmap, 0, bitmapWordCount * sizeof(u64));
+	MemoryFill(blockAllocator->NonEmptyWords, 0, summaryWordCount * sizeof(u64));
 
-	MemoryFill(blockAllocator->BlockBitmap, 0, bitmapWordCount * 8);
+	// Every word starts out with free blocks, the summary's bits past the last word stay cleared
+	for (usz i = 0; i < summaryWordCount; i++) {
+		const usz wordsLeft = bitmapWordCount - (i * 64);
+		blockAllocator->NonFullWords[i] = wordsLeft >= 64 ? U64_MAX : (1ULL << wordsLeft) - 1;
+	}
 
 	return ResultOk;
 }
 
 Result SizedBlockAllocate(SizedBlockAllocator* blockAllocator, void** block)
 {
-	for (usz i = blockAllocator->NextToAllocate; i < blockAllocator->AllocationCapacity; ++i) {
-		if (SizedBlockGetStatus(blockAllocator, i)) {
-			continue;
-		}
+	const usz bitmapWordCount = SizedBlockBitmapWordCount(blockAllocator);
 
-		SizedBlockSetStatus(blockAllocator, i, true);
-		blockAllocator->AllocationCount++;
-		blockAllocator->NextToAllocate = i + 1;
-		*block = SizedBlockGetAddress(blockAllocator, i);
-		return ResultOk;
+	const usz mapIndex = FindSetBit(blockAllocator->NonFullWords, bitmapWordCount, 0);
+	if (mapIndex >= bitmapWordCount) {
+		return ResultOutOfMemory;
 	}
 
-	return ResultOutOfMemory;
+	const u64 freeBlocks = ~blockAllocator->BlockBitmap[mapIndex] & SizedBlockWordMask(blockAllocator, mapIndex);
+	const usz index = (mapIndex * 64) + __builtin_ctzll(freeBlocks);
+
+	SizedBlockSetStatus(blockAllocator, index, true);
+	blockAllocator->AllocationCount++;
+	*block = SizedBlockGetAddress(blockAllocator, index);
+
+	return ResultOk;
 }
 
 Result SizedBlockDeallocate(SizedBlockAllocator* blockAllocator, void* block)
 {
-	if ((u8*)block < blockAllocator->FirstBlock || (u8*)block > blockAllocator->LastBlock) {
+	if ((u8*)block < blockAllocator->FirstBlock
+		|| (u8*)block >= (u8*)SizedBlockGetAddress(blockAllocator, blockAllocator->AllocationCapacity)) {
 		return ResultSerialOutputUnavailable;
 	}
 
@@ -89,29 +185,25 @@ Result SizedBlockDeallocate(SizedBlockAllocator* blockAllocator, void* block)
 	SizedBlockSetStatus(blockAllocator, index, false);
 
 	blockAllocator->AllocationCount--;
-	blockAllocator->NextToAllocate = 0;
 
 	return ResultOk;
 }
 
 Result SizedBlockIterate(SizedBlockAllocator* blockAllocator, void** sizedBlockIterator)
 {
+	usz from = 0;
 	if (*sizedBlockIterator) {
-		*sizedBlockIterator = (u8*)*sizedBlockIterator + blockAllocator->BlockSizeBytes;
-	} else {
-		*sizedBlockIterator = blockAllocator->FirstBlock;
+		from = SizedBlockGetIndex(blockAllocator, *sizedBlockIterator) + 1;
 	}
 
-	for (usz i = SizedBlockGetIndex(blockAllocator, *sizedBlockIterator); i < blockAllocator->AllocationCapacity; ++i) {
-		if (!SizedBlockGetStatus(blockAllocator, i)) {
-			continue;
-		}
-
-		*sizedBlockIterator = SizedBlockGetAddress(blockAllocator, i);
-		return ResultOk;
+	const usz index = SizedBlockFindUsed(blockAllocator, from);
+	if (index >= blockAllocator->AllocationCapacity) {
+		return ResultEndOfIteration;
 	}
 
-	return ResultEndOfIteration;
+	*sizedBlockIterator = SizedBlockGetAddress(blockAllocator, index);
+
+	return ResultOk;
 }
 
 Result SizedBlockCircularIterate(SizedBlockAllocator* blockAllocator, void** sizedBlockIterator)
@@ -120,25 +212,18 @@ Result SizedBlockCircularIterate(SizedBlockAllocator* blockAllocator, void** siz
 		return ResultEndOfIteration;
 	}
 
+	usz from = 0;
 	if (*sizedBlockIterator) {
-		*sizedBlockIterator = (u8*)*sizedBlockIterator + blockAllocator->BlockSizeBytes;
-	} else {
-		*sizedBlockIterator = blockAllocator->FirstBlock;
+		from = SizedBlockGetIndex(blockAllocator, *sizedBlockIterator) + 1;
 	}
 
-	usz i = SizedBlockGetIndex(blockAllocator, *sizedBlockIterator);
-	while (true) {
-		if (i >= blockAllocator->AllocationCapacity) {
-			i = 0;
-			continue;
-		}
+	usz index = SizedBlockFindUsed(blockAllocator, from);
+	if (index >= blockAllocator->AllocationCapacity) {
+		// There's at least one used block, so starting over always finds one
+		index = SizedBlockFindUsed(blockAllocator, 0);
+	}
 
-		if (!SizedBlockGetStatus(blockAllocator, i)) {
-			++i;
-			continue;
-		}
+	*sizedBlockIterator = SizedBlockGetAddress(blockAllocator, index);
 
-		*sizedBlockIterator = SizedBlockGetAddress(blockAllocator, i);
-		return ResultOk;
-	}
+	return ResultOk;
 }
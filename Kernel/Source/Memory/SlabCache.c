@@ -0,0 +1,175 @@
+#include "Memory/SlabCache.h"
+
+#include "Memory/Frame.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/PhysAddr.h"
+
+static void SlabUnlink(Slab** list, Slab* slab)
+{
+	if (slab->Previous) {
+		slab->Previous->Next = slab->Next;
+	} else {
+		*list = slab->Next;
+	}
+
+	if (slab->Next) {
+		slab->Next->Previous = slab->Previous;
+	}
+}
+
+static void SlabPush(Slab** list, Slab* slab)
+{
+	slab->Previous = nullptr;
+	slab->Next = *list;
+	if (*list) {
+		(*list)->Previous = slab;
+	}
+	*list = slab;
+}
+
+static usz SlabSizeBytes(const SlabCache* cache) { return cache->FramesPerSlab * FRAME_4KIB_SIZE_BYTES; }
+
+/// Slabs are aligned to their own size in the physical memory mapping, so the header of an object's slab is right below it.
+static Slab* SlabOf(const SlabCache* cache, void* object) { return (Slab*)__builtin_align_down((VirtAddr)object, SlabSizeBytes(cache)); }
+
+/// Returns the bytes of a slab of the given size not taken up by any objects, including its header.
+static usz SlabWastedBytes(usz objectSizeBytes, usz framesPerSlab)
+{
+	const usz slabSize = framesPerSlab * FRAME_4KIB_SIZE_BYTES;
+
+	return slabSize - (((slabSize - sizeof(Slab)) / objectSizeBytes) * objectSizeBytes);
+}
+
+static Result SlabAllocate(SlabCache* cache, Slab** slab)
+{
+	if (cache->FramesPerSlab == 1) {
+		*slab = PhysAddrAsPointer(AllocateFrame(&g_frameAllocator));
+		return ResultOk;
+	}
+
+	Frame4KiB frames;
+	Result result = AllocateAlignedContiguousFrames(&g_frameAllocator, cache->FramesPerSlab, SlabSizeBytes(cache), &frames);
+	if (result) {
+		return result;
+	}
+
+	*slab = PhysAddrAsPointer(frames);
+
+	return result;
+}
+
+static void SlabRelease(SlabCache* cache, Slab* slab)
+{
+	if (cache->FramesPerSlab == 1) {
+		DeallocateFrame(&g_frameAllocator, PointerAsPhysAddr(slab));
+	} else {
+		DeallocateContiguousFrames(&g_frameAllocator, PointerAsPhysAddr(slab), cache->FramesPerSlab);
+	}
+
+	cache->SlabCount--;
+}
+
+static void SlabListRelease(SlabCache* cache, Slab* slab)
+{
+	while (slab) {
+		Slab* next = slab->Next;
+		SlabRelease(cache, slab);
+		slab = next;
+	}
+}
+
+Result InitSlabCache(SlabCache* cache, usz objectSizeBytes)
+{
+	if (objectSizeBytes < sizeof(void*) || objectSizeBytes > (SLAB_MAX_FRAMES * FRAME_4KIB_SIZE_BYTES) - sizeof(Slab)) {
+		return ResultOutOfRange;
+	}
+
+	cache->PartialSlabs = nullptr;
+	cache->FullSlabs = nullptr;
+	// Keeping the objects pointer aligned, so the free list links in them are too
+	cache->ObjectSizeBytes = __builtin_align_up(objectSizeBytes, sizeof(void*));
+
+	cache->FramesPerSlab = 1;
+	while (cache->FramesPerSlab < SLAB_MAX_FRAMES
+		&& SlabWastedBytes(cache->ObjectSizeBytes, cache->FramesPerSlab) > SlabSizeBytes(cache) / 8) {
+		cache->FramesPerSlab *= 2;
+	}
+
+	cache->ObjectsPerSlab = (SlabSizeBytes(cache) - sizeof(Slab)) / cache->ObjectSizeBytes;
+	cache->SlabCount = 0;
+	cache->ObjectCount = 0;
+
+	return ResultOk;
+}
+
+Result SlabCacheAllocate(SlabCache* cache, void** object)
+{
+	if (!cache->PartialSlabs) {
+		Slab* slab;
+		Result result = SlabAllocate(cache, &slab);
+		if (result) {
+			return result;
+		}
+
+		slab->FreeObjects = nullptr;
+		slab->UsedObjects = 0;
+
+		// Threading the free list from the back, so the objects get handed out in the order of their addresses
+		u8* objects = (u8*)slab + sizeof(Slab);
+		for (usz i = cache->ObjectsPerSlab; i > 0; i--) {
+			void** freeObject = (void**)(objects + ((i - 1) * cache->ObjectSizeBytes));
+			*freeObject = slab->FreeObjects;
+			slab->FreeObjects = freeObject;
+		}
+
+		SlabPush(&cache->PartialSlabs, slab);
+		cache->SlabCount++;
+	}
+
+	Slab* slab = cache->PartialSlabs;
+
+	void** freeObject = slab->FreeObjects;
+	slab->FreeObjects = *freeObject;
+	slab->UsedObjects++;
+	cache->ObjectCount++;
+
+	if (!slab->FreeObjects) {
+		SlabUnlink(&cache->PartialSlabs, slab);
+		SlabPush(&cache->FullSlabs, slab);
+	}
+
+	*object = freeObject;
+
+	return ResultOk;
+}
+
+void SlabCacheDeallocate(SlabCache* cache, void* object)
+{
+	Slab* slab = SlabOf(cache, object);
+
+	if (!slab->FreeObjects) {
+		SlabUnlink(&cache->FullSlabs, slab);
+		SlabPush(&cache->PartialSlabs, slab);
+	}
+
+	*(void**)object = slab->FreeObjects;
+	slab->FreeObjects = object;
+	slab->UsedObjects--;
+	cache->ObjectCount--;
+
+	// An empty slab is kept only while it's the last one with room, so freeing and allocating a single object doesn't thrash
+	if (slab->UsedObjects == 0 && (cache->PartialSlabs != slab || slab->Next)) {
+		SlabUnlink(&cache->PartialSlabs, slab);
+		SlabRelease(cache, slab);
+	}
+}
+
+void SlabCacheRelease(SlabCache* cache)
+{
+	SlabListRelease(cache, cache->PartialSlabs);
+	SlabListRelease(cache, cache->FullSlabs);
+
+	cache->PartialSlabs = nullptr;
+	cache->FullSlabs = nullptr;
+	cache->ObjectCount = 0;
+}
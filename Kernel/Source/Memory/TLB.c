@@ -0,0 +1,141 @@
+#include "Memory/TLB.h"
+
+#include "CPUInfo.h"
+#include "Instructions.h"
+#include "Logger.h"
+#include "Memory/PageTable.h"
+
+TLBState g_tlb = {};
+
+void InitTLB()
+{
+	g_tlb.UsedPCIDs[0] = 1ULL << KERNEL_PCID;
+
+	// Copy-on-write pages have to be read-only for the kernel's writes too, e.g. to buffers passed in syscalls
+	WriteCR0(ReadCR0() | CR0_WP);
+
+	// The bootloader maps the kernel's half as global already, the bit is just ignored until now
+	if (g_cpuInformation.SupportsPGE) {
+		WriteCR4(ReadCR4() | CR4_PGE);
+		g_tlb.GlobalPagesEnabled = true;
+	} else {
+		LogLine(SK_LOG_INFO "Global pages are not supported, kernel TLB entries will be flushed on every address space switch");
+	}
+
+	if (!g_cpuInformation.SupportsPCID || !g_cpuInformation.SupportsINVPCID) {
+		LogLine(SK_LOG_INFO "PCIDs are not supported, every address space switch will flush the TLB");
+		return;
+	}
+
+	// Enabling PCIDs faults unless the currently loaded one is 0, which the caching bits in CR3 would overlap with
+	WriteCR3(ReadCR3() & FRAME_ADDRESS_MASK);
+	WriteCR4(ReadCR4() | CR4_PCIDE);
+
+	g_tlb.PCIDEnabled = true;
+
+	LogLine(SK_LOG_INFO "PCIDs enabled, address space switches will keep the TLB entries");
+}
+
+Result PCIDAllocate(PCID* pcid)
+{
+	if (!g_tlb.PCIDEnabled) {
+		*pcid = KERNEL_PCID;
+		return ResultOk;
+	}
+
+	for (usz i = 0; i < PCID_COUNT / 64; i++) {
+		if (g_tlb.UsedPCIDs[i] == U64_MAX) {
+			continue;
+		}
+
+		const usz bit = __builtin_ctzll(~g_tlb.UsedPCIDs[i]);
+		g_tlb.UsedPCIDs[i] |= 1ULL << bit;
+
+		*pcid = (i * 64) + bit;
+		return ResultOk;
+	}
+
+	return ResultOutOfRange;
+}
+
+void PCIDFree(PCID pcid)
+{
+	if (!g_tlb.PCIDEnabled || pcid == KERNEL_PCID) {
+		return;
+	}
+
+	// The next address space given this PCID must not see any of the old one's translations
+	INVPCID(INVPCIDSingleContext, pcid, 0);
+
+	g_tlb.UsedPCIDs[pcid / 64] &= ~(1ULL << (pcid % 64));
+}
+
+void FlushPage(PCID pcid, VirtAddr address)
+{
+	if (!g_tlb.PCIDEnabled) {
+		INVLPG(address);
+		return;
+	}
+
+	if (address < KERNEL_HALF_BEGIN) {
+		INVPCID(INVPCIDAddress, pcid, address);
+		return;
+	}
+
+	// `invlpg` takes care of the loaded PCID and global entries, the rest of the address spaces need `invpcid`
+	INVLPG(address);
+
+	if (g_tlb.GlobalPagesEnabled) {
+		return;
+	}
+
+	const PCID currentPCID = ReadCR3() & FLAGS_MASK;
+	for (usz i = 0; i < PCID_COUNT / 64; i++) {
+		u64 used = g_tlb.UsedPCIDs[i];
+		while (used) {
+			const PCID usedPCID = (i * 64) + __builtin_ctzll(used);
+			used &= used - 1;
+
+			if (usedPCID != currentPCID) {
+				INVPCID(INVPCIDAddress, usedPCID, address);
+			}
+		}
+	}
+}
+
+void TLBGatherFlush(TLBGather* gather)
+{
+	if (gather->Count > TLB_GATHER_MAX_PAGES) {
+		FlushTLB(gather->PCID);
+	} else {
+		for (usz i = 0; i < gather->Count; i++) {
+			FlushPage(gather->PCID, gather->Pages[i]);
+		}
+	}
+
+	gather->Count = 0;
+}
+
+void FlushTLB(PCID pcid)
+{
+	if (!g_tlb.PCIDEnabled) {
+		// Reloading CR3 leaves global entries alone, toggling global pages off and on is what gets rid of them
+		if (pcid == KERNEL_PCID && g_tlb.GlobalPagesEnabled) {
+			const u64 cr4 = ReadCR4();
+			WriteCR4(cr4 & ~CR4_PGE);
+			WriteCR4(cr4);
+			return;
+		}
+
+		WriteCR3(ReadCR3());
+		return;
+	}
+
+	// Kernel mappings are cached under every PCID
+	if (pcid == KERNEL_PCID) {
+		INVPCID(INVPCIDAllContextsGlobal, 0, 0);
+		return;
+	}
+
+	INVPCID(INVPCIDSingleContext, pcid, 0);
+}
@@ -17,6 +17,13 @@ Result VirtAddrToPhys(const PageTableEntry* p4Table, VirtAddr address, PhysAddr*
 		return ResultSerialOutputUnavailable;
 	}
 
+	// A 1 GiB page, the rest of the address is the offset inside of it
+	if (p3Table[p3Index] & PageHugePage) {
+		*physAddr = p3Table[p3Index] & FRAME_ADDRESS_MASK & ~(HUGE_PAGE_1GIB_OFFSET_MASK);
+		*physAddr |= address & HUGE_PAGE_1GIB_OFFSET_MASK;
+		return ResultOk;
+	}
+
 	u16 p2Index = VirtAddrPage2Index(address);
 	PageTableEntry* p2Table = PhysAddrAsPointer(p3Table[p3Index] & ~(0xfff));
 
@@ -25,6 +32,13 @@ Result VirtAddrToPhys(const PageTableEntry* p4Table, VirtAddr address, PhysAddr*
 		return ResultSerialOutputUnavailable;
 	}
 
+	// A 2 MiB page, the rest of the address is the offset inside of it
+	if (p2Table[p2Index] & PageHugePage) {
+		*physAddr = p2Table[p2Index] & FRAME_ADDRESS_MASK & ~(HUGE_PAGE_2MIB_OFFSET_MASK);
+		*physAddr |= address & HUGE_PAGE_2MIB_OFFSET_MASK;
+		return ResultOk;
+	}
+
 	u16 p1Index = VirtAddrPage1Index(address);
 	PageTableEntry* p1Table = PhysAddrAsPointer(p2Table[p2Index] & ~(0xfff));
 
@@ -3,14 +3,67 @@
 #include "Core.h"
 #include "Logger.h"
 #include "Memory.h"
-#include "Memory/BitmapFrameAllocator.h"
 #include "Memory/Frame.h"
+#include "Memory/FrameAllocator.h"
 #include "Memory/Page.h"
 #include "Memory/PageTable.h"
+#include "Memory/TLB.h"
 #include "Random.h"
 
 VirtualMemoryAllocator g_kernelMemoryAllocator = {};
 
+/// The regions' nodes are their first members.
+static UnusedVirtualRegion* RegionOf(RangeTreeNode* node) { return (UnusedVirtualRegion*)node; }
+
+static usz RegionLargestSize(RangeTreeNode* node) { return node ? RegionOf(node)->LargestSize : 0; }
+
+static usz RegionTotalSize(RangeTreeNode* node) { return node ? RegionOf(node)->TotalSize : 0; }
+
+/// Recomputes the region's subtree sizes from its children.
+static void RegionUpdate(RangeTreeNode* node)
+{
+	UnusedVirtualRegion* region = RegionOf(node);
+	const usz size = node->End - node->Begin;
+	const usz leftLargest = RegionLargestSize(node->Left);
+	const usz rightLargest = RegionLargestSize(node->Right);
+
+	region->LargestSize = size;
+	if (leftLargest > region->LargestSize) {
+		region->LargestSize = leftLargest;
+	}
+	if (rightLargest > region->LargestSize) {
+		region->LargestSize = rightLargest;
+	}
+	region->TotalSize = size + RegionTotalSize(node->Left) + RegionTotalSize(node->Right);
+}
+
+static Result RemoveRegion(VirtualMemoryAllocator* allocator, Page4KiB begin)
+{
+	RangeTreeNode* region = RangeTreeRemove(&allocator->Regions, begin);
+	if (!region) {
+		return ResultNotFound;
+	}
+
+	SlabCacheDeallocate(&allocator->RegionCache, region);
+
+	return ResultOk;
+}
+
+static Result AddRegion(VirtualMemoryAllocator* allocator, Page4KiB begin, Page4KiB end)
+{
+	UnusedVirtualRegion* region = nullptr;
+	Result result = SlabCacheAllocate(&allocator->RegionCache, (void**)&region);
+	if (result) {
+		return result;
+	}
+
+	region->Node.Begin = begin;
+	region->Node.End = end;
+	RangeTreeInsert(&allocator->Regions, &region->Node);
+
+	return result;
+}
+
 static Result GetContainingUnusedRegion(
 	VirtualMemoryAllocator* allocator, Page4KiB begin, Page4KiB end, UnusedVirtualRegion** containingRegion)
 {
@@ -18,20 +71,16 @@ static Result GetContainingUnusedRegion(
 		return ResultInvalidPageAlignment;
 	}
 
-	UnusedVirtualRegion* regionPointer = allocator->List;
-	while (regionPointer) {
-		if (begin >= regionPointer->Begin && end <= regionPointer->End) {
-			if (containingRegion) {
-				*containingRegion = regionPointer;
-			}
-
-			return ResultOk;
-		}
+	RangeTreeNode* region = RangeTreeFloor(&allocator->Regions, begin);
+	if (!region || end > region->End) {
+		return ResultNotFound;
+	}
 
-		regionPointer = regionPointer->Next;
+	if (containingRegion) {
+		*containingRegion = RegionOf(region);
 	}
 
-	return ResultNotFound;
+	return ResultOk;
 }
 
 static Result GetBorderingBegin(VirtualMemoryAllocator* allocator, Page4KiB begin, UnusedVirtualRegion** borderingRegion)
@@ -40,17 +89,14 @@ static Result GetBorderingBegin(VirtualMemoryAllocator* allocator, Page4KiB begi
 		return ResultInvalidPageAlignment;
 	}
 
-	UnusedVirtualRegion* regionPointer = allocator->List;
-	while (regionPointer) {
-		if (regionPointer->End == begin) {
-			*borderingRegion = regionPointer;
-			return ResultOk;
-		}
-
-		regionPointer = regionPointer->Next;
+	// Regions never overlap, so the only one that can end right at the page is the last one beginning below it
+	RangeTreeNode* region = begin > 0 ? RangeTreeFloor(&allocator->Regions, begin - 1) : nullptr;
+	if (!region || region->End != begin) {
+		return ResultNotFound;
 	}
 
-	return ResultNotFound;
+	*borderingRegion = RegionOf(region);
+	return ResultOk;
 }
 
 static Result GetBorderingEnd(VirtualMemoryAllocator* allocator, Page4KiB end, UnusedVirtualRegion** borderingRegion)
@@ -59,87 +105,128 @@ static Result GetBorderingEnd(VirtualMemoryAllocator* allocator, Page4KiB end, U
 		return ResultInvalidPageAlignment;
 	}
 
-	UnusedVirtualRegion* regionPointer = allocator->List;
-	while (regionPointer) {
-		if (regionPointer->Begin == end) {
-			*borderingRegion = regionPointer;
-			return ResultOk;
-		}
+	RangeTreeNode* region = RangeTreeFloor(&allocator->Regions, end);
+	if (!region || region->Begin != end) {
+		return ResultNotFound;
+	}
+
+	*borderingRegion = RegionOf(region);
+	return ResultOk;
+}
 
-		regionPointer = regionPointer->Next;
+/// Returns the lowest page of the region at which an allocation of the given size fits, lying `offset` bytes past an alignment boundary.
+static bool FirstFittingPage(const RangeTreeNode* region, usz size, usz alignment, usz offset, Page4KiB* page)
+{
+	const Page4KiB first = region->Begin + ((offset - region->Begin) & (alignment - 1));
+	if (first < region->Begin || first > region->End || region->End - first < size) {
+		return false;
 	}
 
-	return ResultNotFound;
+	*page = first;
+	return true;
 }
 
-static Result GetRandomRegion(VirtualMemoryAllocator* allocator, usz size, Page4KiB* randomPage)
+/// Returns the lowest region beginning at or above the given page, which an allocation of the given size fits in.
+/// Subtrees without a large enough region are skipped as a whole.
+static RangeTreeNode* FindFittingRegion(RangeTreeNode* root, Page4KiB from, usz size, usz alignment, usz offset, Page4KiB* firstPage)
 {
-	if (!Page4KiBIsAligned(size)) {
-		return ResultInvalidPageAlignment;
+	if (!root || RegionLargestSize(root) < size) {
+		return nullptr;
 	}
 
-	usz regionCount = 0;
-	UnusedVirtualRegion* regionPointer = allocator->List;
-	while (regionPointer) {
-		if (regionPointer->End - regionPointer->Begin >= size) {
-			regionCount++;
+	if (root->Begin >= from) {
+		RangeTreeNode* region = FindFittingRegion(root->Left, from, size, alignment, offset, firstPage);
+		if (region) {
+			return region;
 		}
 
-		regionPointer = regionPointer->Next;
+		if (FirstFittingPage(root, size, alignment, offset, firstPage)) {
+			return root;
+		}
 	}
 
-	if (regionCount == 0) {
-		LogLine(SK_LOG_WARN
-			"Could not find any remaining unused virtual memory regions of suitable size for 0x%x bytes, too much memory usage",
-			size);
-		return ResultOutOfMemory;
+	return FindFittingRegion(root->Right, from, size, alignment, offset, firstPage);
+}
+
+/// Returns the region containing the byte at the given offset, counting only the bytes of unused regions, from the lowest one up.
+static RangeTreeNode* RegionAtUnusedOffset(RangeTreeNode* root, usz offset)
+{
+	while (root) {
+		const usz leftSize = RegionTotalSize(root->Left);
+		if (offset < leftSize) {
+			root = root->Left;
+			continue;
+		}
+
+		offset -= leftSize;
+		if (offset < root->End - root->Begin) {
+			return root;
+		}
+
+		offset -= root->End - root->Begin;
+		root = root->Right;
 	}
 
-	usz randomIndex = RandomU64() % regionCount;
+	return nullptr;
+}
 
-	regionPointer = allocator->List;
-	while (regionPointer) {
-		if (regionPointer->End - regionPointer->Begin >= size) {
-			if (randomIndex == 0) {
-				usz maxOffset = regionPointer->End - regionPointer->Begin - size;
+/// Picks a random unused region of the given size, beginning `offset` bytes past a boundary of the given power of two alignment.
+/// A random unused byte is chosen first, and the allocation goes into the first region fitting it from that byte's region up,
+/// so regions get picked roughly in proportion to their size.
+static Result GetRandomRegion(VirtualMemoryAllocator* allocator, usz size, usz alignment, usz offset, Page4KiB* randomPage)
+{
+	if (!Page4KiBIsAligned(size) || !Page4KiBIsAligned(alignment) || !Page4KiBIsAligned(offset)) {
+		return ResultInvalidPageAlignment;
+	}
 
-				usz pageSlotCount = (maxOffset / PAGE_4KIB_SIZE_BYTES) + 1;
-				usz offsetPages = 0;
-				if (pageSlotCount > 1) {
-					offsetPages = RandomU64() % pageSlotCount;
-				}
+	RangeTreeNode* root = allocator->Regions.Root;
+	RangeTreeNode* region = nullptr;
+	Page4KiB firstPage;
 
-				*randomPage = regionPointer->Begin + offsetPages * PAGE_4KIB_SIZE_BYTES;
-				return ResultOk;
-			}
+	if (RegionLargestSize(root) >= size) {
+		const RangeTreeNode* randomRegion = RegionAtUnusedOffset(root, RandomU64() % RegionTotalSize(root));
 
-			randomIndex--;
+		region = FindFittingRegion(root, randomRegion->Begin, size, alignment, offset, &firstPage);
+		if (!region) {
+			region = FindFittingRegion(root, 0, size, alignment, offset, &firstPage);
 		}
+	}
+
+	if (!region) {
+		LogLine(SK_LOG_WARN
+			"Could not find any remaining unused virtual memory regions of suitable size for 0x%x bytes, too much memory usage",
+			size);
+		return ResultOutOfMemory;
+	}
+
+	usz maxOffset = region->End - firstPage - size;
 
-		regionPointer = regionPointer->Next;
+	usz pageSlotCount = (maxOffset / alignment) + 1;
+	usz offsetPages = 0;
+	if (pageSlotCount > 1) {
+		offsetPages = RandomU64() % pageSlotCount;
 	}
 
-	return ResultOutOfMemory;
+	*randomPage = firstPage + offsetPages * alignment;
+	return ResultOk;
 }
 
-void VirtualMemoryPrintRegions(VirtualMemoryAllocator* allocator)
+static Result PrintRegion(const RangeTreeNode* region, void*)
 {
-	UnusedVirtualRegion* region = allocator->List;
-	while (region) {
-		LogLine(SK_LOG_DEBUG "Region: Begin = 0x%x End = 0x%x", region->Begin, region->End);
-
-		region = region->Next;
-	}
+	LogLine(SK_LOG_DEBUG "Region: Begin = 0x%x End = 0x%x", region->Begin, region->End);
+	return ResultOk;
 }
 
-Result InitKernelVirtualMemory(usz topPML4Entries, Page4KiB backingMemoryBegin, usz backingMemorySize)
+void VirtualMemoryPrintRegions(VirtualMemoryAllocator* allocator) { RangeTreeWalk(&allocator->Regions, PrintRegion, nullptr); }
+
+Result InitKernelVirtualMemory(usz topPML4Entries)
 {
 	Result result = Page4KiBUnmap(PhysAddrAsPointer(g_bootInfo.KernelPML4), g_bootInfo.ContextSwitchFunctionPage);
 	if (result) {
 		return result;
 	}
 
-	FlushPage(g_bootInfo.ContextSwitchFunctionPage);
+	FlushPage(KERNEL_PCID, g_bootInfo.ContextSwitchFunctionPage);
 
 	Frame4KiB kernelPML4Frame = g_bootInfo.KernelPML4;
 	PageTableEntry* kernelPML4 = PhysAddrAsPointer(kernelPML4Frame);
@@ -149,42 +236,23 @@ Result InitKernelVirtualMemory(usz topPML4Entries, Page4KiB backingMemoryBegin,
 			continue;
 		}
 
-		Frame4KiB frame = AllocateFrame(&g_frameAllocator);
-
-		InitEmptyPageTable(PhysAddrAsPointer(frame));
+		Frame4KiB frame = AllocatePageTable();
 
 		kernelPML4[i] = frame | PagePresent | PageWriteable;
 	}
 
-	const Page4KiB endPage = Page4KiBContaining(backingMemoryBegin + backingMemorySize);
-
-	for (Page4KiB poolPage = Page4KiBContaining(backingMemoryBegin); poolPage < endPage; poolPage += PAGE_4KIB_SIZE_BYTES) {
-		Frame4KiB frame = AllocateFrame(&g_frameAllocator);
-
-		PageTableEntry* kernelPML4 = PhysAddrAsPointer(g_bootInfo.KernelPML4);
-		result = Page4KiBMap(kernelPML4, poolPage, frame, PageWriteable);
-		if (result) {
-			return result;
-		}
-	}
-
-	result = InitVirtualMemoryAllocator(&g_kernelMemoryAllocator, (void*)backingMemoryBegin, backingMemorySize, kernelPML4Frame);
+	result = InitVirtualMemoryAllocator(&g_kernelMemoryAllocator, kernelPML4Frame);
 	if (result) {
 		return result;
 	}
 
-	// Exclude everything up to the chosen amount of top PML4 entries
+	// Exclude everything up to the chosen amount of top PML4 entries,
+	// which includes the physical memory mapping and the physical memory map right after it, both placed below them
 	result = MarkVirtualMemoryUsed(&g_kernelMemoryAllocator, 4096, 0xffff800000000000 + (0x8000000000 * (256 - topPML4Entries)));
 	if (result) {
 		return result;
 	}
 
-	// Exclude this list's backing storage
-	result = MarkVirtualMemoryUsed(&g_kernelMemoryAllocator, backingMemoryBegin, backingMemoryBegin + backingMemorySize);
-	if (result) {
-		return result;
-	}
-
 	// Exclude memory currently occupied by the kernel
 	result = MarkVirtualMemoryUsed(&g_kernelMemoryAllocator, g_bootInfo.KernelAddress, g_bootInfo.KernelAddress + g_bootInfo.KernelSize);
 	if (result) {
@@ -199,39 +267,24 @@ Result InitKernelVirtualMemory(usz topPML4Entries, Page4KiB backingMemoryBegin,
 		return result;
 	}
 
-	// TODO: Not assume that the memory map's size is just 4096 bytes
-	// Exclude the physical memory mapping and the physical memory map right after it
-	result = MarkVirtualMemoryUsed(&g_kernelMemoryAllocator, g_bootInfo.PhysicalMemoryOffset,
-		g_bootInfo.PhysicalMemoryOffset + g_bootInfo.PhysicalMemoryMappingSize + 0x1000);
-	if (result) {
-		return result;
-	}
-
 	return result;
 }
 
-Result InitVirtualMemoryAllocator(VirtualMemoryAllocator* allocator, void* listBeginning, usz listSize, Frame4KiB pml4)
+Result InitVirtualMemoryAllocator(VirtualMemoryAllocator* allocator, Frame4KiB pml4)
 {
-	Result result = InitSizedBlockAllocator(&allocator->ListBackingStorage, listBeginning, listSize, sizeof(UnusedVirtualRegion));
+	Result result = InitSlabCache(&allocator->RegionCache, sizeof(UnusedVirtualRegion));
 	if (result) {
 		return result;
 	}
 
-	result = SizedBlockAllocate(&allocator->ListBackingStorage, (void**)&allocator->List);
-	if (result) {
-		return result;
-	}
+	InitRangeTree(&allocator->Regions, RegionUpdate);
+	allocator->PML4 = pml4;
+	allocator->PCID = KERNEL_PCID;
 
 	// The first page should always be unused to catch bugs
 	// The last page is excluded since it's not possible to mark it as used,
 	// because `End` is exclusive so the address would wrap around to 0
-	allocator->List->Begin = PAGE_4KIB_SIZE_BYTES;
-	allocator->List->End = U64_MAX - PAGE_4KIB_SIZE_BYTES + 1;
-	allocator->List->Next = nullptr;
-	allocator->List->Previous = nullptr;
-	allocator->PML4 = pml4;
-
-	return result;
+	return AddRegion(allocator, PAGE_4KIB_SIZE_BYTES, U64_MAX - PAGE_4KIB_SIZE_BYTES + 1);
 }
 
 Result AllocateBackedVirtualMemoryAtAddress(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, Page4KiB pageBegin)
@@ -246,26 +299,66 @@ Result AllocateBackedVirtualMemoryAtAddress(VirtualMemoryAllocator* allocator, u
 		return result;
 	}
 
-	for (Page4KiB page = pageBegin; page < endPage; page += PAGE_4KIB_SIZE_BYTES) {
-		Frame4KiB frame = AllocateFrame(&g_frameAllocator);
+	// The memory is handed out at a fixed address, usually to back ELF segments, which rely on it being zeroed
+	return PageMapRangeAllocated(PhysAddrAsPointer(allocator->PML4), pageBegin, size / PAGE_4KIB_SIZE_BYTES, flags, true);
+}
 
-		result = Page4KiBMap(PhysAddrAsPointer(allocator->PML4), page, frame, flags);
-		if (result) {
-			return result;
-		}
+Result AllocateBackedVirtualMemory(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, void** allocatedPage)
+{
+	Page4KiB pageBegin;
+	Result result = AllocateVirtualRegion(allocator, size, &pageBegin);
+	if (result) {
+		return result;
 	}
 
+	result = PageMapRangeAllocated(PhysAddrAsPointer(allocator->PML4), pageBegin, size / PAGE_4KIB_SIZE_BYTES, flags, false);
+	if (result) {
+		return result;
+	}
+
+	*allocatedPage = (void*)pageBegin;
 	return result;
 }
 
-Result AllocateBackedVirtualMemory(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, void** allocatedPage)
+Result AllocateVirtualRegion(VirtualMemoryAllocator* allocator, usz size, Page4KiB* pageBegin)
 {
 	if (!Page4KiBIsAligned(size)) {
 		return ResultInvalidPageAlignment;
 	}
 
+	Result result = GetRandomRegion(allocator, size, PAGE_4KIB_SIZE_BYTES, 0, pageBegin);
+	if (result) {
+		return result;
+	}
+
+	return MarkVirtualMemoryUsed(allocator, *pageBegin, *pageBegin + size);
+}
+
+Result ReserveVirtualMemory(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, void** reservedPage)
+{
 	Page4KiB pageBegin;
-	Result result = GetRandomRegion(allocator, size, &pageBegin);
+	Result result = AllocateVirtualRegion(allocator, size, &pageBegin);
+	if (result) {
+		return result;
+	}
+
+	result = PageReserveRange(PhysAddrAsPointer(allocator->PML4), pageBegin, size / PAGE_4KIB_SIZE_BYTES, flags);
+	if (result) {
+		return result;
+	}
+
+	*reservedPage = (void*)pageBegin;
+	return result;
+}
+
+Result AllocateHugeBackedVirtualMemory(VirtualMemoryAllocator* allocator, usz size, PageTableEntryFlags flags, void** allocatedPage)
+{
+	if (!Page2MiBIsAligned(size)) {
+		return ResultInvalidPageAlignment;
+	}
+
+	Page4KiB pageBegin;
+	Result result = GetRandomRegion(allocator, size, PAGE_2MIB_SIZE_BYTES, 0, &pageBegin);
 	if (result) {
 		return result;
 	}
@@ -276,10 +369,19 @@ Result AllocateBackedVirtualMemory(VirtualMemoryAllocator* allocator, usz size,
 		return result;
 	}
 
-	for (Page4KiB page = pageBegin; page < endPage; page += PAGE_4KIB_SIZE_BYTES) {
-		Frame4KiB frame = AllocateFrame(&g_frameAllocator);
+	PageTableEntry* pml4 = PhysAddrAsPointer(allocator->PML4);
+	for (Page2MiB page = pageBegin; page < endPage; page += PAGE_2MIB_SIZE_BYTES) {
+		Frame2MiB frame;
+		result = AllocateAlignedContiguousFrames(
+			&g_frameAllocator, FRAME_2MIB_SIZE_BYTES / FRAME_4KIB_SIZE_BYTES, FRAME_2MIB_SIZE_BYTES, &frame);
+
+		// Physical memory might be too fragmented for a whole 2 MiB frame, but 4 KiB ones will do just as well
+		if (result) {
+			result = PageMapRangeAllocated(pml4, page, PAGE_2MIB_SIZE_BYTES / PAGE_4KIB_SIZE_BYTES, flags, false);
+		} else {
+			result = Page2MiBMap(pml4, page, frame, flags);
+		}
 
-		result = Page4KiBMap(PhysAddrAsPointer(allocator->PML4), page, frame, flags);
 		if (result) {
 			return result;
 		}
@@ -303,21 +405,13 @@ Result DeallocateBackedVirtualMemory(VirtualMemoryAllocator* allocator, void* al
 		return result;
 	}
 
-	for (Page4KiB page = allocatedPage; page < endPage; page += PAGE_4KIB_SIZE_BYTES) {
-		Frame4KiB frame;
-		result = VirtAddrToPhys(PhysAddrAsPointer(allocator->PML4), page, &frame);
-		if (result) {
-			return result;
-		}
-
-		DeallocateFrame(&g_frameAllocator, frame);
+	TLBGather gather;
+	TLBGatherInit(&gather, allocator->PCID);
 
-		result = Page4KiBUnmap(PhysAddrAsPointer(allocator->PML4), page);
-		if (result) {
-			return result;
-		}
-
-		FlushPage(page);
+	result = PageUnmapRange(PhysAddrAsPointer(allocator->PML4), allocatedPage, size / PAGE_4KIB_SIZE_BYTES, true, &gather);
+	TLBGatherFlush(&gather);
+	if (result) {
+		return result;
 	}
 
 	return result;
@@ -329,8 +423,12 @@ Result AllocateMMIORegion(VirtualMemoryAllocator* allocator, Frame4KiB begin, us
 		return ResultInvalidPageAlignment;
 	}
 
+	// Placing large regions at the same offset from a 2 MiB boundary as the frames lets most of them be mapped with 2 MiB pages
+	const bool huge = size >= PAGE_2MIB_SIZE_BYTES;
+	const usz alignment = huge ? PAGE_2MIB_SIZE_BYTES : PAGE_4KIB_SIZE_BYTES;
+
 	Page4KiB pageBegin;
-	Result result = GetRandomRegion(allocator, size, &pageBegin);
+	Result result = GetRandomRegion(allocator, size, alignment, begin & (alignment - 1), &pageBegin);
 	if (result) {
 		return result;
 	}
@@ -341,14 +439,13 @@ Result AllocateMMIORegion(VirtualMemoryAllocator* allocator, Frame4KiB begin, us
 		return result;
 	}
 
-	Frame4KiB frame = begin;
-	for (Page4KiB page = pageBegin; page < endPage; page += PAGE_4KIB_SIZE_BYTES) {
-		result = Page4KiBMap(PhysAddrAsPointer(allocator->PML4), page, frame, flags);
-		if (result) {
-			return result;
-		}
-
-		frame += PAGE_4KIB_SIZE_BYTES;
+	if (huge) {
+		result = PageMapRangeHuge(PhysAddrAsPointer(allocator->PML4), pageBegin, size / PAGE_4KIB_SIZE_BYTES, begin, flags);
+	} else {
+		result = PageMapRange(PhysAddrAsPointer(allocator->PML4), pageBegin, size / PAGE_4KIB_SIZE_BYTES, begin, flags);
+	}
+	if (result) {
+		return result;
 	}
 
 	*mmioBegin = (void*)pageBegin;
@@ -369,31 +466,11 @@ Result DeallocateMMIORegion(VirtualMemoryAllocator* allocator, void* mmioBegin,
 		return result;
 	}
 
-	for (Page4KiB page = mmioPage; page < endPage; page += PAGE_4KIB_SIZE_BYTES) {
-		result = Page4KiBUnmap(PhysAddrAsPointer(allocator->PML4), page);
-		if (result) {
-			return result;
-		}
-
-		FlushPage(page);
-	}
-
-	return result;
-}
-
-static Result RemoveRegion(VirtualMemoryAllocator* allocator, UnusedVirtualRegion* region)
-{
-	if (region->Previous) {
-		region->Previous->Next = region->Next;
-	} else {
-		allocator->List = region->Next;
-	}
-
-	if (region->Next) {
-		region->Next->Previous = region->Previous;
-	}
+	TLBGather gather;
+	TLBGatherInit(&gather, allocator->PCID);
 
-	Result result = SizedBlockDeallocate(&allocator->ListBackingStorage, region);
+	result = PageUnmapRange(PhysAddrAsPointer(allocator->PML4), mmioPage, size / PAGE_4KIB_SIZE_BYTES, false, &gather);
+	TLBGatherFlush(&gather);
 	if (result) {
 		return result;
 	}
@@ -401,54 +478,37 @@ static Result RemoveRegion(VirtualMemoryAllocator* allocator, UnusedVirtualRegio
 	return result;
 }
 
-static Result AddRegion(VirtualMemoryAllocator* allocator, Page4KiB begin, Page4KiB end)
+Result MarkVirtualMemoryUsed(VirtualMemoryAllocator* allocator, Page4KiB begin, Page4KiB end)
 {
-	UnusedVirtualRegion* region = nullptr;
-	Result result = SizedBlockAllocate(&allocator->ListBackingStorage, (void**)&region);
+	UnusedVirtualRegion* containingRegion = nullptr;
+	Result result = GetContainingUnusedRegion(allocator, begin, end, &containingRegion);
 	if (result) {
 		return result;
 	}
 
-	region->Begin = begin;
-	region->End = end;
-
-	region->Next = allocator->List;
-	region->Previous = nullptr;
-	if (allocator->List) {
-		allocator->List->Previous = region;
-	}
-	allocator->List = region;
-
-	return result;
-}
+	const Page4KiB regionBegin = containingRegion->Node.Begin;
+	const Page4KiB regionEnd = containingRegion->Node.End;
 
-Result MarkVirtualMemoryUsed(VirtualMemoryAllocator* allocator, Page4KiB begin, Page4KiB end)
-{
-	UnusedVirtualRegion* containingRegion = nullptr;
-	Result result = GetContainingUnusedRegion(allocator, begin, end, &containingRegion);
+	// Removing the region first frees up a node for what's left of it
+	result = RemoveRegion(allocator, regionBegin);
 	if (result) {
 		return result;
 	}
 
-	if (begin > containingRegion->Begin) {
-		result = AddRegion(allocator, containingRegion->Begin, begin);
+	if (begin > regionBegin) {
+		result = AddRegion(allocator, regionBegin, begin);
 		if (result) {
 			return result;
 		}
 	}
 
-	if (end < containingRegion->End) {
-		result = AddRegion(allocator, end, containingRegion->End);
+	if (end < regionEnd) {
+		result = AddRegion(allocator, end, regionEnd);
 		if (result) {
 			return result;
 		}
 	}
 
-	result = RemoveRegion(allocator, containingRegion);
-	if (result) {
-		return result;
-	}
-
 	return result;
 }
 
@@ -457,9 +517,9 @@ Result MarkVirtualMemoryUnused(VirtualMemoryAllocator* allocator, Page4KiB begin
 	UnusedVirtualRegion* region;
 	Result result = GetBorderingBegin(allocator, begin, &region);
 	if (!result) {
-		begin = region->Begin;
+		begin = region->Node.Begin;
 
-		result = RemoveRegion(allocator, region);
+		result = RemoveRegion(allocator, region->Node.Begin);
 		if (result) {
 			return result;
 		}
@@ -467,9 +527,9 @@ Result MarkVirtualMemoryUnused(VirtualMemoryAllocator* allocator, Page4KiB begin
 
 	result = GetBorderingEnd(allocator, end, &region);
 	if (!result) {
-		end = region->End;
+		end = region->Node.End;
 
-		result = RemoveRegion(allocator, region);
+		result = RemoveRegion(allocator, region->Node.Begin);
 		if (result) {
 			return result;
 		}
@@ -483,6 +543,17 @@ Result MarkVirtualMemoryUnused(VirtualMemoryAllocator* allocator, Page4KiB begin
 	return result;
 }
 
+static Result CopyRegion(const RangeTreeNode* region, void* destination) { return AddRegion(destination, region->Begin, region->End); }
+
+Result CopyVirtualMemoryRegions(VirtualMemoryAllocator* destination, const VirtualMemoryAllocator* source)
+{
+	// Every node in the cache belongs to the tree, so they can all go at once
+	SlabCacheRelease(&destination->RegionCache);
+	destination->Regions.Root = nullptr;
+
+	return RangeTreeWalk(&source->Regions, CopyRegion, destination);
+}
+
 Result RemapVirtualMemory(VirtualMemoryAllocator* allocator, Page4KiB begin, usz size, PageTableEntryFlags flags)
 {
 	if (!Page4KiBIsAligned(size) || !Page4KiBIsAligned(begin)) {
@@ -497,20 +568,11 @@ Result RemapVirtualMemory(VirtualMemoryAllocator* allocator, Page4KiB begin, usz
 		return ResultSerialOutputUnavailable;
 	}
 
-	for (Page4KiB page = begin; page < end; page += PAGE_4KIB_SIZE_BYTES) {
-		Frame4KiB frame;
-		result = VirtAddrToPhys(PhysAddrAsPointer(allocator->PML4), page, &frame);
-		if (result) {
-			return result;
-		}
-
-		result = Page4KiBRemap(PhysAddrAsPointer(allocator->PML4), page, frame, flags);
-		if (result) {
-			return result;
-		}
+	TLBGather gather;
+	TLBGatherInit(&gather, allocator->PCID);
 
-		FlushPage(page);
-	}
+	result = PageProtectRange(PhysAddrAsPointer(allocator->PML4), begin, size / PAGE_4KIB_SIZE_BYTES, flags, &gather);
+	TLBGatherFlush(&gather);
 
 	return result;
 }
@@ -0,0 +1,256 @@
+#include "NUMA.h"
+
+#include "ACPI.h"
+#include "CPUInfo.h"
+#include "Logger.h"
+#include "Memory/Frame.h"
+
+/// A single node spanning the whole physical address space, until `InitNUMA` says otherwise.
+NUMATopology g_numa = {
+	.NodeCount = 1,
+	.MemoryRanges = { { .Begin = 0, .End = U64_MAX, .Node = 0 } },
+	.MemoryRangeCount = 1,
+	.Distances = { { NUMA_LOCAL_DISTANCE } },
+};
+
+/// Proximity domains are arbitrary 32-bit numbers, so they get translated into dense node indices in order of appearance.
+static u32 s_proximityDomains[MAX_NUMA_NODES];
+
+static Result NodeFromProximityDomain(u32 proximityDomain, u8* node)
+{
+	for (usz i = 0; i < g_numa.NodeCount; i++) {
+		if (s_proximityDomains[i] == proximityDomain) {
+			*node = i;
+			return ResultOk;
+		}
+	}
+
+	if (g_numa.NodeCount >= MAX_NUMA_NODES) {
+		return ResultOutOfRange;
+	}
+
+	s_proximityDomains[g_numa.NodeCount] = proximityDomain;
+	*node = g_numa.NodeCount++;
+
+	return ResultOk;
+}
+
+static void AddMemoryRange(PhysAddr begin, PhysAddr end, u8 node)
+{
+	if (g_numa.MemoryRangeCount >= MAX_NUMA_MEMORY_RANGES) {
+		LogLine(SK_LOG_WARN "Too many SRAT memory ranges, the range 0x%x - 0x%x is ignored", begin, end);
+		return;
+	}
+
+	// Insertion sort, there are only ever a handful of ranges
+	usz i = g_numa.MemoryRangeCount;
+	while (i > 0 && g_numa.MemoryRanges[i - 1].Begin > begin) {
+		g_numa.MemoryRanges[i] = g_numa.MemoryRanges[i - 1];
+		i--;
+	}
+
+	g_numa.MemoryRanges[i] = (NUMAMemoryRange) { .Begin = begin, .End = end, .Node = node };
+	g_numa.MemoryRangeCount++;
+}
+
+static void AddProcessor(u32 apicID, u8 node)
+{
+	if (g_numa.ProcessorCount >= MAX_CPUS) {
+		return;
+	}
+
+	g_numa.Processors[g_numa.ProcessorCount++] = (NUMAProcessor) { .APICID = apicID, .Node = node };
+}
+
+/// Stretches the ranges so they cover the whole address space without gaps, and merges neighbours belonging to the same node.
+static void NormalizeMemoryRanges()
+{
+	g_numa.MemoryRanges[0].Begin = 0;
+
+	usz merged = 0;
+	for (usz i = 1; i < g_numa.MemoryRangeCount; i++) {
+		if (g_numa.MemoryRanges[i].Node == g_numa.MemoryRanges[merged].Node) {
+			continue;
+		}
+
+		// Boundaries are kept frame aligned, so every frame belongs to exactly one node
+		const PhysAddr boundary = __builtin_align_down(g_numa.MemoryRanges[i].Begin, FRAME_4KIB_SIZE_BYTES);
+
+		g_numa.MemoryRanges[merged].End = boundary;
+		g_numa.MemoryRanges[++merged] = g_numa.MemoryRanges[i];
+		g_numa.MemoryRanges[merged].Begin = boundary;
+	}
+
+	g_numa.MemoryRanges[merged].End = U64_MAX;
+	g_numa.MemoryRangeCount = merged + 1;
+}
+
+static Result ParseSRAT(const SRAT* srat)
+{
+	if (srat->Header.Length <= sizeof(SRAT)) {
+		return ResultOk;
+	}
+
+	Result result = ResultOk;
+	u8 node = 0;
+
+	SRATBaseEntry* entry = (SRATBaseEntry*)srat->Entries;
+	do {
+		if (entry->Type == SRATEntryProcessorAPICAffinity) {
+			const SRATEntryAPIC* apicEntry = (SRATEntryAPIC*)entry;
+			if (!(apicEntry->Flags & SRAT_ENTRY_ENABLED)) {
+				continue;
+			}
+
+			const u32 proximityDomain = apicEntry->ProximityDomainLow | ((u32)apicEntry->ProximityDomainHigh[0] << 8)
+				| ((u32)apicEntry->ProximityDomainHigh[1] << 16) | ((u32)apicEntry->ProximityDomainHigh[2] << 24);
+
+			result = NodeFromProximityDomain(proximityDomain, &node);
+			if (result) {
+				return result;
+			}
+
+			AddProcessor(apicEntry->APICID, node);
+		} else if (entry->Type == SRATEntryProcessorX2APICAffinity) {
+			const SRATEntryX2APIC* x2apicEntry = (SRATEntryX2APIC*)entry;
+			if (!(x2apicEntry->Flags & SRAT_ENTRY_ENABLED)) {
+				continue;
+			}
+
+			result = NodeFromProximityDomain(x2apicEntry->ProximityDomain, &node);
+			if (result) {
+				return result;
+			}
+
+			AddProcessor(x2apicEntry->X2APICID, node);
+		} else if (entry->Type == SRATEntryMemoryAffinity) {
+			const SRATEntryMemory* memoryEntry = (SRATEntryMemory*)entry;
+			if (!(memoryEntry->Flags & SRAT_ENTRY_ENABLED) || !memoryEntry->Length) {
+				continue;
+			}
+
+			result = NodeFromProximityDomain(memoryEntry->ProximityDomain, &node);
+			if (result) {
+				return result;
+			}
+
+			AddMemoryRange(memoryEntry->BaseAddress, memoryEntry->BaseAddress + memoryEntry->Length, node);
+		}
+	} while (SRATGetEntry(srat, &entry));
+
+	return result;
+}
+
+static void ParseSLIT(const SLIT* slit)
+{
+	for (usz from = 0; from < g_numa.NodeCount; from++) {
+		for (usz to = 0; to < g_numa.NodeCount; to++) {
+			if (s_proximityDomains[from] >= slit->LocalityCount || s_proximityDomains[to] >= slit->LocalityCount) {
+				continue;
+			}
+
+			g_numa.Distances[from][to] = slit->Entries[(s_proximityDomains[from] * slit->LocalityCount) + s_proximityDomains[to]];
+		}
+	}
+}
+
+static void ComputeFallbackOrder()
+{
+	for (usz node = 0; node < g_numa.NodeCount; node++) {
+		u8* order = g_numa.FallbackOrder[node];
+
+		// Insertion sort by distance, ties keep the node order so the node itself always comes first
+		for (usz i = 0; i < g_numa.NodeCount; i++) {
+			usz j = i;
+			while (j > 0 && g_numa.Distances[node][order[j - 1]] > g_numa.Distances[node][i]) {
+				order[j] = order[j - 1];
+				j--;
+			}
+
+			order[j] = i;
+		}
+	}
+}
+
+/// Finds the bootstrap processor's APIC ID and looks up its node, the application processors will do the same once brought up.
+static void AssignBootstrapProcessorNode()
+{
+	CPUIDResult cpuid = {};
+	u32 apicID = 0;
+
+	if (!CPUID(&g_cpuInformation, 0xb, 0, &cpuid) && cpuid.EBX) {
+		apicID = cpuid.EDX;
+	} else if (!CPUID(&g_cpuInformation, 1, 0, &cpuid)) {
+		apicID = cpuid.EBX >> 24;
+	}
+
+	for (usz i = 0; i < g_numa.ProcessorCount; i++) {
+		if (g_numa.Processors[i].APICID == apicID) {
+			g_numa.CPUNodes[0] = g_numa.Processors[i].Node;
+			return;
+		}
+	}
+}
+
+Result InitNUMA()
+{
+	PhysAddr sratAddress;
+	Result result = GetACPITableAddress("SRAT", &sratAddress);
+	if (result) {
+		LogLine(SK_LOG_INFO "No SRAT found, treating the machine as a single NUMA node");
+		return ResultOk;
+	}
+
+	g_numa.NodeCount = 0;
+	g_numa.MemoryRangeCount = 0;
+	g_numa.ProcessorCount = 0;
+
+	result = ParseSRAT(PhysAddrAsPointer(sratAddress));
+	if (result) {
+		LogLine(SK_LOG_WARN "The SRAT describes more than %u NUMA nodes, treating the machine as a single NUMA node", MAX_NUMA_NODES);
+	}
+
+	// An SRAT without any memory can't say anything useful either, so in both cases fall back to a single node
+	if (result || !g_numa.NodeCount || !g_numa.MemoryRangeCount) {
+		g_numa.NodeCount = 1;
+		g_numa.MemoryRangeCount = 0;
+		g_numa.ProcessorCount = 0;
+		AddMemoryRange(0, U64_MAX, 0);
+	}
+
+	NormalizeMemoryRanges();
+
+	for (usz from = 0; from < g_numa.NodeCount; from++) {
+		for (usz to = 0; to < g_numa.NodeCount; to++) {
+			g_numa.Distances[from][to] = from == to ? NUMA_LOCAL_DISTANCE : NUMA_REMOTE_DISTANCE;
+		}
+	}
+
+	PhysAddr slitAddress;
+	if (!GetACPITableAddress("SLIT", &slitAddress)) {
+		ParseSLIT(PhysAddrAsPointer(slitAddress));
+	}
+
+	ComputeFallbackOrder();
+	AssignBootstrapProcessorNode();
+
+	for (usz i = 0; i < g_numa.MemoryRangeCount; i++) {
+		const NUMAMemoryRange* range = &g_numa.MemoryRanges[i];
+		LogLine(SK_LOG_DEBUG "NUMA memory range: Begin = 0x%x End = 0x%x Node = %u", range->Begin, range->End, (u64)range->Node);
+	}
+
+	LogLine(SK_LOG_INFO "Detected %u NUMA nodes, the bootstrap processor belongs to node %u", g_numa.NodeCount, (u64)g_numa.CPUNodes[0]);
+
+	return ResultOk;
+}
+
+const NUMAMemoryRange* NUMARangeContaining(PhysAddr address)
+{
+	// The ranges cover everything, so the last one beginning at or before the address is the right one
+	usz i = g_numa.MemoryRangeCount - 1;
+	while (i > 0 && g_numa.MemoryRanges[i].Begin > address) {
+		i--;
+	}
+
+	return &g_numa.MemoryRanges[i];
+}
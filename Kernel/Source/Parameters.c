@@ -8,6 +8,7 @@ void ParseKernelParams()
 {
 	// Default parameter values
 	g_parameters.ASLR = true;
+	g_parameters.BuddyAllocator = false;
 	g_parameters.InitProcess = "X:/Init";
 
 	i8* p = g_bootInfo.Args;
@@ -44,6 +45,8 @@ void ParseKernelParams()
 
 		if (!value && keyLength == 6 && MemoryCompare(key, "NoASLR", keyLength)) {
 			g_parameters.ASLR = false;
+		} else if (!value && keyLength == 14 && MemoryCompare(key, "BuddyAllocator", keyLength)) {
+			g_parameters.BuddyAllocator = true;
 		} else if (value && keyLength == 11 && MemoryCompare(key, "InitProcess", keyLength)) {
 			g_parameters.InitProcess = value;
 		}
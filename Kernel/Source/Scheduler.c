@@ -4,10 +4,13 @@
 #include "GDT.h"
 #include "Instructions.h"
 #include "Memory.h"
-#include "Memory/BitmapFrameAllocator.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/Heap.h"
 #include "Memory/Page.h"
 #include "Memory/PageTable.h"
+#include "Memory/SharedMemory.h"
 #include "Memory/SizedBlockAllocator.h"
+#include "Memory/TLB.h"
 #include "Random.h"
 #include "Result.h"
 #include "Storage/VirtualFileSystem.h"
@@ -17,8 +20,19 @@ Scheduler g_scheduler;
 static Result AllocateThreadStack(Process* process, usz size, PageTableEntryFlags flags, Page4KiB* stackTop)
 {
 	// TODO: Add random stack offset support (subtract a random number between 0 and 4096 from the stack top and align it to 16 bytes)
+	// User stacks only get backed as deep as they grow, kernel stacks can't be, as the page fault handler itself runs on them
 	void* stackBottom;
-	Result result = AllocateBackedVirtualMemory(&process->VirtualMemoryAllocator, size, flags, &stackBottom);
+	Result result;
+	if (flags & PageUserAccessible) {
+		result = ReserveVirtualMemory(&process->VirtualMemoryAllocator, size, flags, &stackBottom);
+	} else {
+		result = AllocateBackedVirtualMemory(&process->VirtualMemoryAllocator, size, flags, &stackBottom);
+	}
+	if (result) {
+		return result;
+	}
+
+	result = MappedRegionAdd(&process->MappedRegions, (Page4KiB)stackBottom, (Page4KiB)stackBottom + size, flags, MappedRegionStack);
 	if (result) {
 		return result;
 	}
@@ -55,18 +69,10 @@ Result ProcessTerminateStart(Process* process)
 		}
 	}
 
-	ELFSegmentRegion* elfSegmentRegionIter = nullptr;
-	while (!SizedBlockIterate(&process->ELFSegmentMap, (void**)&elfSegmentRegionIter)) {
-		usz size = elfSegmentRegionIter->End - elfSegmentRegionIter->Begin;
-		result = DeallocateBackedVirtualMemory(&process->VirtualMemoryAllocator, (void*)elfSegmentRegionIter->Begin, size);
-		if (result) {
-			return result;
-		}
-	}
-
-	// As long as all of the virtual memory allocator's regions have been properly freed, its backing memory can simply be deallocated
+	// The ELF segments themselves get released together with the rest of the user half once the process is finished off,
+	// so only the map's backing memory has to be deallocated here
 	// The bitmaps always start at the exact beginning of the backing memory pool, so I can just point to them when deallocating
-	result = DeallocateBackedVirtualMemory(&g_kernelMemoryAllocator, process->ELFSegmentMap.BlockBitmap, PAGE_4KIB_SIZE_BYTES);
+	result = HeapDeallocate(&g_kernelHeap, process->ELFSegmentMap.BlockBitmap, process->ELFSegmentMap.PoolSizeBytes);
 	if (result) {
 		return result;
 	}
@@ -80,7 +86,14 @@ Result ProcessTerminateStart(Process* process)
 			return result;
 		}
 	}
-	result = DeallocateBackedVirtualMemory(&g_kernelMemoryAllocator, process->FileDescriptors.BlockBitmap, PAGE_4KIB_SIZE_BYTES);
+	result = HeapDeallocate(&g_kernelHeap, process->FileDescriptors.BlockBitmap, process->FileDescriptors.PoolSizeBytes);
+	if (result) {
+		return result;
+	}
+
+	// Just like the ELF segments, the mapped frames themselves go away with the user half, the objects only lose their references
+	SharedMemoryReleaseMappings(process);
+	result = HeapDeallocate(&g_kernelHeap, process->SharedMemoryMappings.BlockBitmap, process->SharedMemoryMappings.PoolSizeBytes);
 	if (result) {
 		return result;
 	}
@@ -103,16 +116,15 @@ Result ProcessTerminateFinish(Process* process)
 		}
 	}
 
-	result
-		= DeallocateBackedVirtualMemory(&g_kernelMemoryAllocator, process->VirtualMemoryAllocator.ListBackingStorage.BlockBitmap, 102400);
-	if (result) {
-		return result;
-	}
+	SlabCacheRelease(&process->VirtualMemoryAllocator.RegionCache);
+	MappedRegionTreeRelease(&process->MappedRegions);
 
-	// Deallocate the process's PML4
-	// TODO: Deallocate the intermediate frames in the page table setup (levels 1, 2 and 3)
+	// Everything still mapped in the user half goes away in a single pass, the kernel half is shared and stays as it is
+	PageReleaseUserHalf(PhysAddrAsPointer(process->PML4));
 	DeallocateFrame(&g_frameAllocator, process->PML4);
 
+	PCIDFree(process->PCID);
+
 	result = SizedBlockDeallocate(&g_scheduler.Processes, process);
 	if (result) {
 		return result;
@@ -132,6 +144,11 @@ Result ThreadTerminateStart(Thread* thread)
 		return result;
 	}
 
+	result = MappedRegionRemove(&process->MappedRegions, thread->UserStackTop - THREAD_USER_STACK_SIZE_BYTES);
+	if (result) {
+		return result;
+	}
+
 	return result;
 }
 
@@ -149,6 +166,11 @@ Result ThreadTerminateFinish(Thread* thread)
 		return result;
 	}
 
+	result = MappedRegionRemove(&process->MappedRegions, thread->KernelStackTop - THREAD_KERNEL_STACK_SIZE_BYTES);
+	if (result) {
+		return result;
+	}
+
 	result = SizedBlockDeallocate(&g_scheduler.Threads, thread);
 	if (result) {
 		return result;
@@ -159,7 +181,7 @@ Result ThreadTerminateFinish(Thread* thread)
 	return result;
 }
 
-Result ProcessCreate(Process** createdProcess)
+static Result ProcessAllocate(Process** createdProcess)
 {
 	Process* process = nullptr;
 	Result result = SizedBlockAllocate(&g_scheduler.Processes, (void**)&process);
@@ -167,52 +189,74 @@ Result ProcessCreate(Process** createdProcess)
 		return result;
 	}
 
+	const usz fileDescriptorsPoolSize = SizedBlockPoolSizeBytes(sizeof(ProcessFileDescriptor), MAX_FILE_DESCRIPTORS);
 	void* fileDescriptorsPool;
-	result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, PAGE_4KIB_SIZE_BYTES, PageWriteable, &fileDescriptorsPool);
+	result = HeapAllocate(&g_kernelHeap, fileDescriptorsPoolSize, &fileDescriptorsPool);
 	if (result) {
-		return result;
+		goto DeallocateProcess;
 	}
 
-	result = InitSizedBlockAllocator(&process->FileDescriptors, fileDescriptorsPool, PAGE_4KIB_SIZE_BYTES, sizeof(ProcessFileDescriptor));
+	result = InitSizedBlockAllocator(
+		&process->FileDescriptors, fileDescriptorsPool, fileDescriptorsPoolSize, sizeof(ProcessFileDescriptor));
 	if (result) {
-		return result;
+		goto DeallocateFileDescriptors;
 	}
 
+	const usz elfSegmentMapPoolSize = SizedBlockPoolSizeBytes(sizeof(ELFSegmentRegion), MAX_ELF_SEGMENTS);
 	void* elfSegmentMapPool;
-	result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, PAGE_4KIB_SIZE_BYTES, PageWriteable, &elfSegmentMapPool);
+	result = HeapAllocate(&g_kernelHeap, elfSegmentMapPoolSize, &elfSegmentMapPool);
 	if (result) {
-		return result;
+		goto DeallocateFileDescriptors;
 	}
 
-	result = InitSizedBlockAllocator(&process->ELFSegmentMap, elfSegmentMapPool, PAGE_4KIB_SIZE_BYTES, sizeof(ELFSegmentRegion));
+	result = InitSizedBlockAllocator(&process->ELFSegmentMap, elfSegmentMapPool, elfSegmentMapPoolSize, sizeof(ELFSegmentRegion));
 	if (result) {
-		return result;
+		goto DeallocateELFSegmentMap;
 	}
 
-	Frame4KiB pml4Frame = AllocateFrame(&g_frameAllocator);
+	const usz sharedMemoryMappingsPoolSize = SizedBlockPoolSizeBytes(sizeof(SharedMemoryMapping), MAX_SHARED_MEMORY_MAPPINGS);
+	void* sharedMemoryMappingsPool;
+	result = HeapAllocate(&g_kernelHeap, sharedMemoryMappingsPoolSize, &sharedMemoryMappingsPool);
+	if (result) {
+		goto DeallocateELFSegmentMap;
+	}
+
+	result = InitSizedBlockAllocator(
+		&process->SharedMemoryMappings, sharedMemoryMappingsPool, sharedMemoryMappingsPoolSize, sizeof(SharedMemoryMapping));
+	if (result) {
+		goto DeallocateSharedMemoryMappings;
+	}
+
+	Frame4KiB pml4Frame = AllocatePageTable();
 	PageTableEntry* processPML4 = PhysAddrAsPointer(pml4Frame);
-	InitEmptyPageTable(processPML4);
 
-	void* virtualMemoryAllocatorPool;
-	result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, 102400, PageWriteable, &virtualMemoryAllocatorPool);
+	// Neither of the two leaves anything allocated behind when it fails
+	result = InitVirtualMemoryAllocator(&process->VirtualMemoryAllocator, pml4Frame);
 	if (result) {
-		return result;
+		goto DeallocatePML4;
 	}
 
-	result = InitVirtualMemoryAllocator(&process->VirtualMemoryAllocator, virtualMemoryAllocatorPool, 102400, pml4Frame);
+	result = InitMappedRegionTree(&process->MappedRegions);
 	if (result) {
-		return result;
+		goto ReleaseVirtualMemoryAllocator;
 	}
 
-	result = MarkVirtualMemoryUsed(&process->VirtualMemoryAllocator, 0x800000000000, U64_MAX - PAGE_4KIB_SIZE_BYTES + 1);
+	result = PCIDAllocate(&process->PCID);
 	if (result) {
-		return result;
+		goto ReleaseMappedRegions;
+	}
+
+	process->VirtualMemoryAllocator.PCID = process->PCID;
+
+	result = MarkVirtualMemoryUsed(&process->VirtualMemoryAllocator, USER_HALF_END, U64_MAX - PAGE_4KIB_SIZE_BYTES + 1);
+	if (result) {
+		goto FreePCID;
 	}
 
 	Thread* mainThread = nullptr;
 	result = SizedBlockAllocate(&g_scheduler.Threads, (void**)&mainThread);
 	if (result) {
-		return result;
+		goto FreePCID;
 	}
 
 	process->PML4 = pml4Frame;
@@ -223,15 +267,67 @@ Result ProcessCreate(Process** createdProcess)
 	process->Threads[0] = mainThread;
 	process->MainThread = mainThread;
 
+	// The whole kernel half is shared, from the physical memory mapping spanning as many entries as there is RAM,
+	// up to the top entries populated at boot for the kernel's own mappings, so none of them ever change afterwards
 	PageTableEntry* kernelPML4 = PhysAddrAsPointer(g_bootInfo.KernelPML4);
-	processPML4[510] = kernelPML4[510] & ~PageUserAccessible;
-	processPML4[511] = kernelPML4[511] & ~PageUserAccessible;
+	for (usz i = PAGE_TABLE_ENTRIES / 2; i < PAGE_TABLE_ENTRIES; i++) {
+		processPML4[i] = kernelPML4[i] & ~PageUserAccessible;
+	}
 
 	mainThread->ID = GetThreadID();
 	mainThread->ParentProcess = process;
 
+	*createdProcess = process;
+
+	return result;
+
+FreePCID:
+	PCIDFree(process->PCID);
+ReleaseMappedRegions:
+	MappedRegionTreeRelease(&process->MappedRegions);
+ReleaseVirtualMemoryAllocator:
+	SlabCacheRelease(&process->VirtualMemoryAllocator.RegionCache);
+DeallocatePML4:
+	DeallocateFrame(&g_frameAllocator, pml4Frame);
+DeallocateSharedMemoryMappings:
+	HeapDeallocate(&g_kernelHeap, sharedMemoryMappingsPool, sharedMemoryMappingsPoolSize);
+DeallocateELFSegmentMap:
+	HeapDeallocate(&g_kernelHeap, elfSegmentMapPool, elfSegmentMapPoolSize);
+DeallocateFileDescriptors:
+	HeapDeallocate(&g_kernelHeap, fileDescriptorsPool, fileDescriptorsPoolSize);
+DeallocateProcess:
+	SizedBlockDeallocate(&g_scheduler.Processes, process);
+
+	return result;
+}
+
+/// Gives back everything of a process that failed to get set up after `ProcessAllocate`, it must have never run.
+/// Whatever got mapped into its user half by then goes away along with it.
+static void ProcessDiscard(Process* process)
+{
+	SharedMemoryReleaseMappings(process);
+	HeapDeallocate(&g_kernelHeap, process->SharedMemoryMappings.BlockBitmap, process->SharedMemoryMappings.PoolSizeBytes);
+	HeapDeallocate(&g_kernelHeap, process->ELFSegmentMap.BlockBitmap, process->ELFSegmentMap.PoolSizeBytes);
+	HeapDeallocate(&g_kernelHeap, process->FileDescriptors.BlockBitmap, process->FileDescriptors.PoolSizeBytes);
+
+	SlabCacheRelease(&process->VirtualMemoryAllocator.RegionCache);
+	MappedRegionTreeRelease(&process->MappedRegions);
+
+	PageReleaseUserHalf(PhysAddrAsPointer(process->PML4));
+	DeallocateFrame(&g_frameAllocator, process->PML4);
+	PCIDFree(process->PCID);
+
+	SizedBlockDeallocate(&g_scheduler.Threads, process->MainThread);
+	SizedBlockDeallocate(&g_scheduler.Processes, process);
+}
+
+/// Gives a new process's main thread its stacks and a context that starts off in the userspace.
+static Result MainThreadSetUp(Process* process)
+{
+	Thread* mainThread = process->MainThread;
+
 	Page4KiB userStackTop;
-	result = AllocateThreadStack(process, THREAD_USER_STACK_SIZE_BYTES, PageWriteable | PageUserAccessible, &userStackTop);
+	Result result = AllocateThreadStack(process, THREAD_USER_STACK_SIZE_BYTES, PageWriteable | PageUserAccessible, &userStackTop);
 	if (result) {
 		return result;
 	}
@@ -245,7 +341,7 @@ Result ProcessCreate(Process** createdProcess)
 	mainThread->KernelStackTop = kernelStackTop;
 
 	MemoryFill(&mainThread->Context, 0, sizeof(CPUContext));
-	mainThread->Context.CR3 = pml4Frame;
+	mainThread->Context.CR3 = TLBAddressSpaceCR3(process->PML4, process->PCID);
 	mainThread->Context.InterruptFrame.RSP = userStackTop;
 	mainThread->Context.RBP = 0;
 	mainThread->Context.InterruptFrame.RFLAGS = 0x202;
@@ -254,8 +350,119 @@ Result ProcessCreate(Process** createdProcess)
 	mainThread->Context.InterruptFrame.SS = GDT_ENTRY_USER_DATA;
 	mainThread->Status = ThreadStartingUp;
 
+	return result;
+}
+
+/// Sets a new process up as a copy of the thread's one, sharing all of its userspace memory copy-on-write.
+static Result ProcessDuplicate(const Thread* parentThread, const CPUContext* context, Process** createdProcess)
+{
+	Process* parent = parentThread->ParentProcess;
+
+	Process* process;
+	Result result = ProcessAllocate(&process);
+	if (result) {
+		return result;
+	}
+
+	result = CopyVirtualMemoryRegions(&process->VirtualMemoryAllocator, &parent->VirtualMemoryAllocator);
+	if (result) {
+		goto DiscardProcess;
+	}
+
+	result = MappedRegionTreeCopy(&process->MappedRegions, &parent->MappedRegions);
+	if (result) {
+		goto DiscardProcess;
+	}
+
+	// The parent's writeable pages turn read-only, which its TLB entries have to reflect
+	TLBGather gather;
+	TLBGatherInit(&gather, parent->PCID);
+	PageShareUserHalf(PhysAddrAsPointer(parent->PML4), PhysAddrAsPointer(process->PML4), &gather);
+	TLBGatherFlush(&gather);
+
+	// Kernel stacks are never shared, so the regions of the parent's ones are free in the copy
+	for (usz i = 0; i < MAX_THREADS_PER_PROCESS; i++) {
+		const Thread* thread = parent->Threads[i];
+		if (!thread) {
+			continue;
+		}
+
+		result = MarkVirtualMemoryUnused(
+			&process->VirtualMemoryAllocator, thread->KernelStackTop - THREAD_KERNEL_STACK_SIZE_BYTES, thread->KernelStackTop);
+		if (result) {
+			goto DiscardProcess;
+		}
+
+		result = MappedRegionRemove(&process->MappedRegions, thread->KernelStackTop - THREAD_KERNEL_STACK_SIZE_BYTES);
+		if (result) {
+			goto DiscardProcess;
+		}
+	}
+
+	ELFSegmentRegion* elfSegmentRegionIter = nullptr;
+	while (!SizedBlockIterate(&parent->ELFSegmentMap, (void**)&elfSegmentRegionIter)) {
+		ELFSegmentRegion* elfSegmentRegion;
+		result = SizedBlockAllocate(&process->ELFSegmentMap, (void**)&elfSegmentRegion);
+		if (result) {
+			goto DiscardProcess;
+		}
+
+		*elfSegmentRegion = *elfSegmentRegionIter;
+	}
+
+	// The shared memory stayed mapped at the same addresses, the copy just has to hold its own references to the objects
+	result = SharedMemoryCopyMappings(process, parent);
+	if (result) {
+		goto DiscardProcess;
+	}
+
+	Thread* mainThread = process->MainThread;
+
+	Page4KiB kernelStackTop;
+	result = AllocateThreadStack(process, THREAD_KERNEL_STACK_SIZE_BYTES, PageWriteable, &kernelStackTop);
+	if (result) {
+		goto DiscardProcess;
+	}
+
+	// The user stack is already there, at the same address as the thread's one
+	mainThread->UserStackTop = parentThread->UserStackTop;
+	mainThread->KernelStackTop = kernelStackTop;
+	mainThread->Context = *context;
+	mainThread->Context.CR3 = TLBAddressSpaceCR3(process->PML4, process->PCID);
+	mainThread->Status = ThreadStartingUp;
+
 	*createdProcess = process;
 
+	return result;
+
+DiscardProcess:
+	ProcessDiscard(process);
+
+	return result;
+}
+
+Result ProcessCreate(Process** createdProcess)
+{
+	// Everything allocated for the new process counts towards the scheduler in the memory statistics
+	const FrameTag previousTag = FrameAllocatorSetTag(&g_frameAllocator, FrameTagScheduler);
+	Result result = ProcessAllocate(createdProcess);
+	if (!result) {
+		result = MainThreadSetUp(*createdProcess);
+		if (result) {
+			ProcessDiscard(*createdProcess);
+		}
+	}
+	FrameAllocatorSetTag(&g_frameAllocator, previousTag);
+
+	return result;
+}
+
+Result ProcessFork(const Thread* thread, const CPUContext* context, Process** createdProcess)
+{
+	const FrameTag previousTag = FrameAllocatorSetTag(&g_frameAllocator, FrameTagScheduler);
+	Result result = ProcessDuplicate(thread, context, createdProcess);
+	FrameAllocatorSetTag(&g_frameAllocator, previousTag);
+
 	return result;
 }
 
@@ -263,7 +470,7 @@ void ThreadLaunch(Thread* thread) { thread->Status = ThreadReady; }
 
 Result InitScheduler()
 {
-	usz processPoolSize = sizeof(Process) * MAX_PROCESSES;
+	usz processPoolSize = SizedBlockPoolSizeBytes(sizeof(Process), MAX_PROCESSES);
 	void* processPool;
 	Result result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, Page4KiBNext(processPoolSize), PageWriteable, &processPool);
 	if (result) {
@@ -275,7 +482,7 @@ Result InitScheduler()
 		return result;
 	}
 
-	usz threadPoolSize = sizeof(Thread) * MAX_PROCESSES * MAX_THREADS_PER_PROCESS;
+	usz threadPoolSize = SizedBlockPoolSizeBytes(sizeof(Thread), MAX_PROCESSES * MAX_THREADS_PER_PROCESS);
 	void* threadPool;
 	result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, Page4KiBNext(threadPoolSize), PageWriteable, &threadPool);
 	if (result) {
@@ -295,6 +502,7 @@ Result InitScheduler()
 
 	kernelProcess->ID = 0;
 	kernelProcess->PML4 = g_bootInfo.KernelPML4;
+	kernelProcess->PCID = KERNEL_PCID;
 	kernelProcess->ThreadCount = 1;
 	for (usz i = 0; i < MAX_THREADS_PER_PROCESS; i++) {
 		kernelProcess->Threads[i] = nullptr;
@@ -309,20 +517,21 @@ Result InitScheduler()
 	kernelProcess->Threads[0] = kernelMainThread;
 	kernelMainThread->ID = 0;
 	kernelMainThread->Status = ThreadRunning;
-	kernelMainThread->Context.CR3 = kernelProcess->PML4;
+	kernelMainThread->Context.CR3 = TLBAddressSpaceCR3(kernelProcess->PML4, kernelProcess->PCID);
 	g_scheduler.CurrentThread = kernelMainThread;
 	kernelMainThread->UserStackTop = g_bootInfo.KernelStackTop;
 	kernelMainThread->KernelStackTop = (Page4KiB)g_kernelInterruptStack + sizeof g_kernelInterruptStack;
 	kernelMainThread->ParentProcess = kernelProcess;
 
+	const usz fileDescriptorsPoolSize = SizedBlockPoolSizeBytes(sizeof(ProcessFileDescriptor), MAX_FILE_DESCRIPTORS);
 	void* fileDescriptorsPool;
-	result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, PAGE_4KIB_SIZE_BYTES, PageWriteable, &fileDescriptorsPool);
+	result = HeapAllocate(&g_kernelHeap, fileDescriptorsPoolSize, &fileDescriptorsPool);
 	if (result) {
 		return result;
 	}
 
 	result = InitSizedBlockAllocator(
-		&kernelProcess->FileDescriptors, fileDescriptorsPool, PAGE_4KIB_SIZE_BYTES, sizeof(ProcessFileDescriptor));
+		&kernelProcess->FileDescriptors, fileDescriptorsPool, fileDescriptorsPoolSize, sizeof(ProcessFileDescriptor));
 	if (result) {
 		return result;
 	}
@@ -330,9 +539,9 @@ Result InitScheduler()
 	return result;
 }
 
-void ProcessStepInto(Process* process) { __asm__ volatile("movq %0, %%cr3" ::"r"(process->PML4) : "memory"); }
+void ProcessStepInto(Process* process) { WriteCR3(TLBAddressSpaceCR3(process->PML4, process->PCID)); }
 
-void ProcessStepOut() { __asm__ volatile("movq %0, %%cr3" ::"r"(g_bootInfo.KernelPML4) : "memory"); }
+void ProcessStepOut() { WriteCR3(TLBAddressSpaceCR3(g_bootInfo.KernelPML4, KERNEL_PCID)); }
 
 void ScheduleInterrupt(CPUContext* cpuContext)
 {
@@ -362,8 +571,11 @@ void ScheduleInterrupt(CPUContext* cpuContext)
 
 		g_tss.RSP[0] = g_scheduler.CurrentThread->KernelStackTop;
 
-		return;
+		break;
 	}
+
+	// Whichever address space gets loaded, its TLB entries are still valid
+	cpuContext->CR3 = TLBNoFlushCR3(cpuContext->CR3);
 }
 
 void ScheduleDiscardStart()
@@ -385,4 +597,8 @@ void ScheduleDiscardStart()
 	}
 }
 
-void ScheduleDiscardFinish(CPUContext* cpuContext) { *cpuContext = g_scheduler.CurrentThread->Context; }
+void ScheduleDiscardFinish(CPUContext* cpuContext)
+{
+	*cpuContext = g_scheduler.CurrentThread->Context;
+	cpuContext->CR3 = TLBNoFlushCR3(cpuContext->CR3);
+}
@@ -1,7 +1,7 @@
 #include "Storage/Drivers/AHCI.h"
 
 #include "Memory.h"
-#include "Memory/BitmapFrameAllocator.h"
+#include "Memory/FrameAllocator.h"
 #include "PCI.h"
 
 AHCIDriver g_ahciDriver;
@@ -36,7 +36,11 @@ static Result AHCIDeviceAllocateCommandTables(AHCIDevice* device)
 		AHCICommandHeader* command = device->CommandList + i;
 
 		// I allocate a single frame, even though this isn't technically enough for an entire command table
-		Frame4KiB frame = AllocateFrame(&g_frameAllocator);
+		Frame4KiB frame;
+		Result result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &frame);
+		if (result) {
+			return result;
+		}
 
 		command->CTBA = frame & 0xffffffff;
 		command->CTBAU = frame >> 32;
@@ -66,16 +70,23 @@ Result AHCIReset(AHCIDriver* ahci)
 	// Disable interrupts
 	ahci->Registers->GHC &= ~(1 << 1);
 	// Enable AHCI mode after reset
-	ahci->Registers->GHC &= ~(1 << 31);
+	ahci->Registers->GHC |= 1U << 31;
 
-	// Check for 64-bit addressing support
-	if (!((ahci->Registers->GHC >> 31) & 1)) {
-		return ResultAHCI64BitAddressingUnsupported;
-	}
+	// Controllers without 64-bit addressing support can still be used, as long as every buffer they touch lies below 4 GiB
+	ahci->DMAZone = (ahci->Registers->CAP >> 31) & 1 ? FrameZoneNormal : FrameZoneDMA32;
 
 	return ResultOk;
 }
 
+Result AHCIAllocateDMAFrames(const AHCIDriver* ahci, usz count, Frame4KiB* frame)
+{
+	const FrameTag previousTag = FrameAllocatorSetTag(&g_frameAllocator, FrameTagAHCI);
+	Result result = AllocateContiguousFramesInZone(&g_frameAllocator, ahci->DMAZone, count, frame);
+	FrameAllocatorSetTag(&g_frameAllocator, previousTag);
+
+	return result;
+}
+
 /// Helper function for filling out the devices sector information.
 static Result AHCIDeviceIdentify(AHCIDevice* device)
 {
@@ -87,7 +98,11 @@ static Result AHCIDeviceIdentify(AHCIDevice* device)
 
 	AHCICommandTable* commandTable = AHCICommandHeaderGetCommandTable(commandHeader);
 
-	Frame4KiB identifyFrame = AllocateFrame(&g_frameAllocator);
+	Frame4KiB identifyFrame;
+	Result result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &identifyFrame);
+	if (result) {
+		return result;
+	}
 	MemoryFill(PhysAddrAsPointer(identifyFrame), 0, FRAME_4KIB_SIZE_BYTES);
 
 	commandTable->PRDT[0].DBA = identifyFrame & 0xffffffff;
@@ -133,17 +148,25 @@ Result AHCIDeviceInit(AHCIDevice* device)
 	// Clear all ATA errors
 	device->Registers->SERR = ~0;
 
-	Frame4KiB receivedFisFrame = AllocateFrame(&g_frameAllocator);
+	Frame4KiB receivedFisFrame;
+	Result result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &receivedFisFrame);
+	if (result) {
+		return result;
+	}
 	device->Registers->FB = receivedFisFrame & 0xffffffff;
 	device->Registers->FBU = receivedFisFrame >> 32;
 
-	Frame4KiB commandListFrame = AllocateFrame(&g_frameAllocator);
+	Frame4KiB commandListFrame;
+	result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &commandListFrame);
+	if (result) {
+		return result;
+	}
 	device->Registers->CLB = commandListFrame & 0xffffffff;
 	device->Registers->CLBU = commandListFrame >> 32;
 
 	device->CommandList = PhysAddrAsPointer(commandListFrame);
 
-	Result result = AHCIDeviceAllocateCommandTables(device);
+	result = AHCIDeviceAllocateCommandTables(device);
 	if (result) {
 		return result;
 	}
@@ -243,14 +266,18 @@ Result InitAHCI()
 
 	g_ahciDriver.Registers = g_pciStorageDevices[0].MostUsefulBAR;
 
-	AHCIReset(&g_ahciDriver);
+	Result result = AHCIReset(&g_ahciDriver);
+	if (result) {
+		return result;
+	}
+
 	for (u8 i = 0; i < 32; i++) {
 		if (!((g_ahciDriver.Registers->PI >> i) & 1) || !(g_ahciDriver.Registers->Ports[i].SSTS & HBA_PORT_DEVICE_PRESENT))
 			continue;
 
 		g_ahciDriver.Devices[0].Registers = g_ahciDriver.Registers->Ports + i;
 		g_ahciDriver.Devices[0].Port = i;
-		Result result = AHCIDeviceInit(&g_ahciDriver.Devices[0]);
+		result = AHCIDeviceInit(&g_ahciDriver.Devices[0]);
 		if (result) {
 			return result;
 		}
@@ -1,7 +1,7 @@
 #include "Storage/Filesystems/Ext2.h"
 
 #include "Memory.h"
-#include "Memory/BitmapFrameAllocator.h"
+#include "Memory/FrameAllocator.h"
 #include "Storage/Drivers/AHCI.h"
 #include "Storage/GPT.h"
 
@@ -36,7 +36,11 @@ Result GetInodeFromPath(Ext2Driver* ext2, const i8* filePath, Frame4KiB inodeTab
 
 	Ext2INode* currentInode = ext2->RootInode;
 
-	Frame4KiB directoryEntriesFrame = AllocateFrame(&g_frameAllocator);
+	Frame4KiB directoryEntriesFrame;
+	Result result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &directoryEntriesFrame);
+	if (result) {
+		return result;
+	}
 
 	// Currently, when this algorithm encounters a symlink it will most likely shit itself
 	while (filePath[end]) {
@@ -48,7 +52,7 @@ Result GetInodeFromPath(Ext2Driver* ext2, const i8* filePath, Frame4KiB inodeTab
 		while (filePath[end] && filePath[end] != '/')
 			end++;
 
-		Result result = AHCIDeviceReadSectors(&g_ahciDriver.Devices[0],
+		result = AHCIDeviceReadSectors(&g_ahciDriver.Devices[0],
 			g_usablePartitions[0].StartLBA + ((usz)currentInode->DirectPointers[0] * 8), 8, directoryEntriesFrame);
 		if (result) {
 			DeallocateFrame(&g_frameAllocator, directoryEntriesFrame);
@@ -98,8 +102,13 @@ Result GetInodeFromPath(Ext2Driver* ext2, const i8* filePath, Frame4KiB inodeTab
 
 Result InitExt2()
 {
-	Frame4KiB superblockFrame = AllocateFrame(&g_frameAllocator);
-	Result result = AHCIDeviceReadSectors(&g_ahciDriver.Devices[0], g_usablePartitions[0].StartLBA + 2, 2, superblockFrame);
+	Frame4KiB superblockFrame;
+	Result result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &superblockFrame);
+	if (result) {
+		return result;
+	}
+
+	result = AHCIDeviceReadSectors(&g_ahciDriver.Devices[0], g_usablePartitions[0].StartLBA + 2, 2, superblockFrame);
 	if (result) {
 		return result;
 	}
@@ -108,20 +117,35 @@ Result InitExt2()
 	g_ext2Driver.BlockGroupCount
 		= (g_ext2Driver.Superblock->InodeCount + g_ext2Driver.Superblock->InodesPerGroup - 1) / g_ext2Driver.Superblock->InodesPerGroup;
 
-	Frame4KiB bgdtFrame = AllocateFrame(&g_frameAllocator);
+	Frame4KiB bgdtFrame;
+	result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &bgdtFrame);
+	if (result) {
+		return result;
+	}
+
 	result = AHCIDeviceReadSectors(&g_ahciDriver.Devices[0], g_usablePartitions[0].StartLBA + 8, 2, bgdtFrame);
 	if (result) {
 		return result;
 	}
 	g_ext2Driver.BlockGroupDescriptorTable = PhysAddrAsPointer(bgdtFrame);
 
-	Frame4KiB rootInodeFrame = AllocateFrame(&g_frameAllocator);
+	Frame4KiB rootInodeFrame;
+	result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &rootInodeFrame);
+	if (result) {
+		return result;
+	}
+
 	result = GetInode(&g_ext2Driver, 2, rootInodeFrame, &g_ext2Driver.RootInode);
 	if (result) {
 		return result;
 	}
 
-	Frame4KiB rootDirectoryEntriesFrame = AllocateFrame(&g_frameAllocator);
+	Frame4KiB rootDirectoryEntriesFrame;
+	result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &rootDirectoryEntriesFrame);
+	if (result) {
+		return result;
+	}
+
 	result = AHCIDeviceReadSectors(
 		&g_ahciDriver.Devices[0], 2048 + (g_ext2Driver.RootInode->DirectPointers[0] * 8), 8, rootDirectoryEntriesFrame);
 	if (result) {
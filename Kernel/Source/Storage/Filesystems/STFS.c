@@ -1,13 +1,14 @@
 #include "Storage/Filesystems/STFS.h"
 
 #include "Memory.h"
+#include "Memory/VirtAddr.h"
 #include "Memory/VirtualMemoryAllocator.h"
 
 STFSDriver g_stfsDriver;
 
 Result InitSTFS()
 {
-	usz inodeTablePoolSize = Page4KiBNext(sizeof(STFSFileListEntry) * STFS_MAX_OPENED_INODES);
+	usz inodeTablePoolSize = Page4KiBNext(SizedBlockPoolSizeBytes(sizeof(STFSFileListEntry), STFS_MAX_OPENED_INODES));
 
 	void* inodeTablePool;
 	Result result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, inodeTablePoolSize, PageWriteable, &inodeTablePool);
@@ -109,3 +110,16 @@ Result STFSFileLookupID(const i8* fileName, u64* id)
 
 	return ResultNotFound;
 }
+
+Result STFSFileGetPage(void* fileSystemSpecific, usz fileOffset, Frame4KiB* frame)
+{
+	STFSFileListEntry* fileListEntry = fileSystemSpecific;
+	const VirtAddr page = (VirtAddr)g_bootInfo.Ramdisk + fileListEntry->FileContentOffset + fileOffset;
+
+	// A page only partially covered by the file would expose the neighbouring files' contents as well
+	if (!Page4KiBIsAligned(page) || fileOffset + PAGE_4KIB_SIZE_BYTES > fileListEntry->FileSize) {
+		return ResultNotFound;
+	}
+
+	return VirtAddrToPhys(PhysAddrAsPointer(g_bootInfo.KernelPML4), page, frame);
+}
@@ -2,8 +2,8 @@
 
 #include "Logger.h"
 #include "Memory.h"
-#include "Memory/BitmapFrameAllocator.h"
 #include "Memory/Frame.h"
+#include "Memory/FrameAllocator.h"
 #include "Memory/PhysAddr.h"
 #include "Storage/Drivers/AHCI.h"
 
@@ -13,8 +13,13 @@ Result DetectGPTPartitions()
 {
 	// For now I just assume that the first partition is usable :D
 	// Like with everything I will later implement support for multiple partitions or whatever
-	Frame4KiB partitionTableHeader = AllocateFrame(&g_frameAllocator);
-	Result result = AHCIDeviceReadSectors(&g_ahciDriver.Devices[0], 1, 1, partitionTableHeader);
+	Frame4KiB partitionTableHeader;
+	Result result = AHCIAllocateDMAFrames(&g_ahciDriver, 1, &partitionTableHeader);
+	if (result) {
+		return result;
+	}
+
+	result = AHCIDeviceReadSectors(&g_ahciDriver.Devices[0], 1, 1, partitionTableHeader);
 	if (result) {
 		return result;
 	}
@@ -30,7 +35,7 @@ Result DetectGPTPartitions()
 	usz neededFrames = (neededSectors + 7) / 8;
 
 	Frame4KiB tableStartFrame;
-	result = AllocateContiguousFrames(&g_frameAllocator, neededFrames, &tableStartFrame);
+	result = AHCIAllocateDMAFrames(&g_ahciDriver, neededFrames, &tableStartFrame);
 	if (result) {
 		return result;
 	}
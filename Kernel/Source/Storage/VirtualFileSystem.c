@@ -1,5 +1,6 @@
 #include "Storage/VirtualFileSystem.h"
 
+#include "Memory/FrameAllocator.h"
 #include "Memory/Page.h"
 #include "Memory/PageTable.h"
 #include "Memory/VirtualMemoryAllocator.h"
@@ -10,7 +11,7 @@ VirtualFileSystem g_virtualFileSystem;
 
 Result InitVirtualFileSystem(VirtualFileSystem* fileSystem)
 {
-	usz mountpointPoolSize = Page4KiBNext(sizeof(Mountpoint) * MAX_MOUNTPOINTS);
+	usz mountpointPoolSize = Page4KiBNext(SizedBlockPoolSizeBytes(sizeof(Mountpoint), MAX_MOUNTPOINTS));
 	void* mountpointPool;
 	Result result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, mountpointPoolSize, PageWriteable, &mountpointPool);
 	if (result) {
@@ -22,7 +23,7 @@ Result InitVirtualFileSystem(VirtualFileSystem* fileSystem)
 		return result;
 	}
 
-	usz openedFilesPoolSize = Page4KiBNext(sizeof(OpenedFile) * MAX_OPENED_FILES);
+	usz openedFilesPoolSize = Page4KiBNext(SizedBlockPoolSizeBytes(sizeof(OpenedFile), MAX_OPENED_FILES));
 	void* openedFilesPool;
 	result = AllocateBackedVirtualMemory(&g_kernelMemoryAllocator, openedFilesPoolSize, PageWriteable, &openedFilesPool);
 	if (result) {
@@ -40,7 +41,8 @@ Result InitVirtualFileSystem(VirtualFileSystem* fileSystem)
 		.FileRead = STFSFileRead,
 		.FileLookupID = STFSFileLookupID,
 		.FileInformation = STFSFileInformation,
-		.FileClose = STFSFileClose };
+		.FileClose = STFSFileClose,
+		.FileGetPage = STFSFileGetPage };
 	result = MountpointCreate(fileSystem, 'X', MountpointReadable, &stfsFunctions);
 	if (result) {
 		return result;
@@ -359,3 +361,118 @@ Result FileClose(VirtualFileSystem* fileSystem, usz fileDescriptor)
 
 	return result;
 }
+
+/// Finds the frame to back a single page of a mapped file with, along with the extra flags it has to be mapped with.
+static Result FileGetMappedPage(
+	OpenedFile* openedFile, usz fileOffset, PageTableEntryFlags flags, Frame4KiB* frame, PageTableEntryFlags* pageFlags)
+{
+	const MountpointFunctions* functions = &openedFile->Mountpoint->Functions;
+
+	if (functions->FileGetPage && !functions->FileGetPage(openedFile->FileSystemSpecific, fileOffset, frame)) {
+		// The filesystem's frame may only ever be written to once it's copied
+		*pageFlags = flags & PageWriteable ? (flags & ~PageWriteable) | PageCopyOnWrite | PageBorrowed : flags | PageBorrowed;
+		return ResultOk;
+	}
+
+	*frame = AllocateZeroedFrame(&g_frameAllocator);
+	*pageFlags = flags;
+
+	const usz fileSize = openedFile->CachedInformation.Size;
+	if (fileOffset >= fileSize) {
+		return ResultOk;
+	}
+
+	const usz countBytes = fileSize - fileOffset < PAGE_4KIB_SIZE_BYTES ? fileSize - fileOffset : PAGE_4KIB_SIZE_BYTES;
+	Result result = functions->FileRead(openedFile->FileSystemSpecific, fileOffset, countBytes, PhysAddrAsPointer(*frame));
+	if (result) {
+		DeallocateFrame(&g_frameAllocator, *frame);
+		return result;
+	}
+
+	return result;
+}
+
+Result FileMap(usz fileDescriptor, usz offsetBytes, usz countBytes, PageTableEntryFlags flags, void** mapping)
+{
+	Process* process = g_scheduler.CurrentThread->ParentProcess;
+
+	if (!SizedBlockGetStatus(&process->FileDescriptors, fileDescriptor)) {
+		return ResultSerialOutputUnavailable;
+	}
+
+	if (!Page4KiBIsAligned(offsetBytes) || !Page4KiBIsAligned(countBytes)) {
+		return ResultInvalidPageAlignment;
+	}
+
+	ProcessFileDescriptor* descriptor = SizedBlockGetAddress(&process->FileDescriptors, fileDescriptor);
+	OpenedFile* openedFile = descriptor->OpenedFile;
+
+	if (countBytes == 0 || offsetBytes >= openedFile->CachedInformation.Size) {
+		return ResultOutOfRange;
+	}
+
+	Page4KiB mappingBegin;
+	Result result = AllocateVirtualRegion(&process->VirtualMemoryAllocator, countBytes, &mappingBegin);
+	if (result) {
+		return result;
+	}
+
+	PageTableEntry* pml4 = PhysAddrAsPointer(process->PML4);
+	flags |= PageUserAccessible;
+
+	usz mappedBytes = 0;
+	for (; mappedBytes < countBytes; mappedBytes += PAGE_4KIB_SIZE_BYTES) {
+		Frame4KiB frame;
+		PageTableEntryFlags pageFlags;
+		result = FileGetMappedPage(openedFile, offsetBytes + mappedBytes, flags, &frame, &pageFlags);
+		if (result) {
+			break;
+		}
+
+		result = Page4KiBMap(pml4, mappingBegin + mappedBytes, frame, pageFlags);
+		if (result) {
+			// The page never got mapped, so it's not covered by the cleanup below
+			if (!(pageFlags & PageBorrowed)) {
+				DeallocateFrame(&g_frameAllocator, frame);
+			}
+
+			break;
+		}
+	}
+
+	if (!result) {
+		result = MappedRegionAdd(&process->MappedRegions, mappingBegin, mappingBegin + countBytes, flags, MappedRegionFile);
+	}
+
+	if (result) {
+		// Give back whatever got mapped before the failure
+		if (mappedBytes > 0) {
+			PageUnmapRange(pml4, mappingBegin, mappedBytes / PAGE_4KIB_SIZE_BYTES, true, nullptr);
+		}
+
+		MarkVirtualMemoryUnused(&process->VirtualMemoryAllocator, mappingBegin, mappingBegin + countBytes);
+		return result;
+	}
+
+	*mapping = (void*)mappingBegin;
+	return result;
+}
+
+Result FileUnmap(void* mapping, usz countBytes)
+{
+	Process* process = g_scheduler.CurrentThread->ParentProcess;
+
+	const MappedRegion* region = MappedRegionFind(&process->MappedRegions, (VirtAddr)mapping);
+	if (!region || region->Node.Begin != (Page4KiB)mapping || region->Node.End - region->Node.Begin != countBytes
+		|| region->Backing != MappedRegionFile) {
+		return ResultNotFound;
+	}
+
+	// Frames borrowed from the filesystem are left alone, only the copies get deallocated
+	Result result = DeallocateBackedVirtualMemory(&process->VirtualMemoryAllocator, mapping, countBytes);
+	if (result) {
+		return result;
+	}
+
+	return MappedRegionRemove(&process->MappedRegions, (Page4KiB)mapping);
+}
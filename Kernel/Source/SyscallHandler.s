@@ -1,12 +1,15 @@
 .global SyscallHandler
+.global ScProcessFork
 
 .extern ScheduleProcessTerminate
+.extern ScProcessForkWithRegisters
 .extern g_syscallFunctions
 .extern g_scheduler
 
 .equ CURRENT_THREAD_OFFSET, 128
 .equ THREAD_RSP, 168
 .equ THREAD_KERNEL_STACK_TOP, 192
+.equ SYSCALL_COUNT, 9
 
 SyscallHandler:
 	pushq %rcx
@@ -20,7 +23,7 @@ SyscallHandler:
 	movq %rsp, THREAD_RSP(%rbx)
 	movq THREAD_KERNEL_STACK_TOP(%rbx), %rsp
 
-	cmp $3, %rax
+	cmp $SYSCALL_COUNT, %rax
 	jae .Error
 
 	movq %r10, %rcx
@@ -53,3 +56,18 @@ SyscallHandler:
 	popq %rcx
 
 	sysretq
+
+// The copy made by the fork syscall has to start off with the caller's callee-saved registers,
+// which have to be saved before any C code gets to use them
+ScProcessFork:
+	pushq %r15
+	pushq %r14
+	pushq %r13
+	pushq %r12
+	pushq %rbp
+
+	movq %rsp, %rdi
+	call ScProcessForkWithRegisters
+
+	addq $40, %rsp
+	ret
@@ -3,12 +3,22 @@
 #include "GDT.h"
 #include "Scheduler.h"
 #include "Logger.h"
+#include "Memory.h"
 #include "Instructions.h"
+#include "Memory/MappedRegionTree.h"
+#include "Memory/SharedMemory.h"
+#include "Memory/TLB.h"
 #include "Memory/VirtAddr.h"
 #include "Panic.h"
 #include "Result.h"
+#include "Storage/VirtualFileSystem.h"
 
-VirtAddr g_syscallFunctions[3] = { (VirtAddr)ScProcessTerminate, (VirtAddr)ScTest, (VirtAddr)ScPrint };
+/// `SYSCALL_COUNT` in the syscall handler bounds the index into `g_syscallFunctions` with it.
+_Static_assert(SYSCALL_COUNT == 9, "SYSCALL_COUNT must match its copy in SyscallHandler.s");
+
+VirtAddr g_syscallFunctions[SYSCALL_COUNT] = { (VirtAddr)ScProcessTerminate, (VirtAddr)ScTest, (VirtAddr)ScPrint,
+	(VirtAddr)ScFrameStatistics, (VirtAddr)ScSharedMemoryMap, (VirtAddr)ScSharedMemoryUnmap, (VirtAddr)ScFileMap, (VirtAddr)ScFileUnmap,
+	(VirtAddr)ScProcessFork };
 
 void ScProcessTerminate(usz processID)
 {
@@ -34,6 +44,159 @@ Result ScPrint(const i8* text)
 	return ResultOk;
 }
 
+/// Checks whether the whole buffer lies in the current process's mapped regions, all of which have the given flags.
+/// The lower half also holds every thread's kernel stack, so just checking the address isn't enough.
+static bool UserBufferHasFlags(const void* buffer, usz sizeBytes, PageTableEntryFlags flags)
+{
+	const VirtAddr begin = (VirtAddr)buffer;
+	if (begin >= USER_HALF_END || sizeBytes > USER_HALF_END - begin) {
+		return false;
+	}
+
+	const Process* process = g_scheduler.CurrentThread->ParentProcess;
+	for (VirtAddr address = begin; address < begin + sizeBytes;) {
+		const MappedRegion* region = MappedRegionFind(&process->MappedRegions, address);
+		if (!region || (region->Flags & flags) != flags) {
+			return false;
+		}
+
+		address = region->Node.End;
+	}
+
+	return true;
+}
+
+/// LibSaturn keeps its own copy of the struct, which has to be updated along with this.
+_Static_assert(sizeof(FrameStatistics) == 264, "FrameStatistics must match its LibSaturn copy");
+
+Result ScFrameStatistics(FrameStatistics* statistics)
+{
+	if (!UserBufferHasFlags(statistics, sizeof(FrameStatistics), PageUserAccessible | PageWriteable)) {
+		return ResultOutOfRange;
+	}
+
+	FrameStatistics snapshot;
+	FrameAllocatorGetStatistics(&g_frameAllocator, &snapshot);
+	MemoryCopy(&snapshot, statistics, sizeof(FrameStatistics));
+
+	return ResultOk;
+}
+
+Result ScSharedMemoryMap(const i8* name, usz sizeBytes, bool writeable, void** mapping)
+{
+	if (sizeBytes > MAX_SHARED_MEMORY_SIZE) {
+		return ResultOutOfRange;
+	}
+
+	if (!UserBufferHasFlags(mapping, sizeof(void*), PageUserAccessible | PageWriteable)) {
+		return ResultOutOfRange;
+	}
+
+	// The name is copied byte by byte, so it can't be changed or unmapped while the kernel looks at it
+	i8 kernelName[SHARED_MEMORY_NAME_SIZE];
+	for (usz i = 0; i < SHARED_MEMORY_NAME_SIZE; i++) {
+		if (!UserBufferHasFlags(name + i, 1, PageUserAccessible)) {
+			return ResultInvalidPath;
+		}
+
+		kernelName[i] = name[i];
+		if (!kernelName[i]) {
+			break;
+		}
+
+		if (i == SHARED_MEMORY_NAME_SIZE - 1) {
+			return ResultInvalidPath;
+		}
+	}
+
+	Process* process = g_scheduler.CurrentThread->ParentProcess;
+	void* kernelMapping;
+	Result result = SharedMemoryMap(process, kernelName, sizeBytes, writeable ? PageWriteable : 0, &kernelMapping);
+	if (result) {
+		return result;
+	}
+
+	*mapping = kernelMapping;
+
+	return result;
+}
+
+Result ScSharedMemoryUnmap(void* mapping)
+{
+	return SharedMemoryUnmap(g_scheduler.CurrentThread->ParentProcess, mapping);
+}
+
+Result ScFileMap(usz fileDescriptor, usz offsetBytes, usz countBytes, bool writeable, void** mapping)
+{
+	if (!UserBufferHasFlags(mapping, sizeof(void*), PageUserAccessible | PageWriteable)) {
+		return ResultOutOfRange;
+	}
+
+	if (!SizedBlockGetStatus(&g_scheduler.CurrentThread->ParentProcess->FileDescriptors, fileDescriptor)) {
+		return ResultNotFound;
+	}
+
+	void* kernelMapping;
+	Result result = FileMap(fileDescriptor, offsetBytes, countBytes, writeable ? PageWriteable : 0, &kernelMapping);
+	if (result) {
+		return result;
+	}
+
+	*mapping = kernelMapping;
+
+	return result;
+}
+
+Result ScFileUnmap(void* mapping, usz countBytes) { return FileUnmap(mapping, countBytes); }
+
+/// What the syscall handler pushes onto the user stack, before saving the stack's pointer in the thread's context.
+typedef struct SyscallUserFrame {
+	u64 RBX;
+	/// Saved in R11 by the `syscall` instruction.
+	u64 RFLAGS;
+	/// Saved in RCX by the `syscall` instruction.
+	u64 RIP;
+} SyscallUserFrame;
+
+/// `THREAD_RSP` in the syscall handler relies on it.
+_Static_assert(__builtin_offsetof(Thread, Context.InterruptFrame.RSP) == 168, "The thread's saved RSP must stay at offset 168");
+
+u64 ScProcessForkWithRegisters(const SyscallPreservedRegisters* registers)
+{
+	Thread* thread = g_scheduler.CurrentThread;
+
+	const SyscallUserFrame* frame = (const SyscallUserFrame*)thread->Context.InterruptFrame.RSP;
+	if (!UserBufferHasFlags(frame, sizeof(SyscallUserFrame), PageUserAccessible | PageWriteable)) {
+		return PROCESS_FORK_FAILED;
+	}
+
+	// The copy resumes right where `sysretq` would have left the caller, just with the syscall returning 0
+	CPUContext context;
+	MemoryFill(&context, 0, sizeof(CPUContext));
+	context.RBX = frame->RBX;
+	context.RBP = registers->RBP;
+	context.R12 = registers->R12;
+	context.R13 = registers->R13;
+	context.R14 = registers->R14;
+	context.R15 = registers->R15;
+	context.InterruptFrame.RIP = frame->RIP;
+	context.InterruptFrame.RSP = (u64)(frame + 1);
+	context.InterruptFrame.RFLAGS = 0x202;
+	context.InterruptFrame.CS = GDT_ENTRY_USER_CODE;
+	context.InterruptFrame.SS = GDT_ENTRY_USER_DATA;
+
+	Process* process;
+	Result result = ProcessFork(thread, &context, &process);
+	if (result) {
+		LogLine(SK_LOG_WARN "Could not fork process %u: %r", thread->ParentProcess->ID, result);
+		return PROCESS_FORK_FAILED;
+	}
+
+	ThreadLaunch(process->MainThread);
+
+	return process->ID;
+}
+
 void InitSyscalls()
 {
 	u64 efer = ReadMSR(MSR_EFER);
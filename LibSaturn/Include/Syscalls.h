@@ -3,8 +3,43 @@
 constexpr u64 SYSCALL_PROCESS_TERMINATE = 0;
 constexpr u64 SYSCALL_TEST = 1;
 constexpr u64 SYSCALL_PRINT = 2;
+constexpr u64 SYSCALL_FRAME_STATISTICS = 3;
+constexpr u64 SYSCALL_SHARED_MEMORY_MAP = 4;
+constexpr u64 SYSCALL_SHARED_MEMORY_UNMAP = 5;
+constexpr u64 SYSCALL_FILE_MAP = 6;
+constexpr u64 SYSCALL_FILE_UNMAP = 7;
+constexpr u64 SYSCALL_PROCESS_FORK = 8;
+
+/// Returned by `ScProcessFork` in place of a process ID.
+constexpr u64 PROCESS_FORK_FAILED = U64_MAX;
+
+/// A snapshot of the kernel's physical memory usage, must be kept in sync with the kernel's `FrameStatistics`.
+typedef struct FrameStatistics {
+	/// Indexed by zone, DMA32 (below 4 GiB) and Normal.
+	u64 TotalFrames[2];
+	u64 FreeFrames[2];
+	u64 CachedFrames;
+	u64 DeferredFrames;
+	/// Bucket `i` counts runs of 2^i up to 2^(i+1) - 1 contiguous free frames, the last one also counts all of the longer runs.
+	u64 FreeRuns[19];
+	u64 LargestFreeRun;
+	/// Indexed by tag: untagged, page tables, AHCI, scheduler, ELF segments, file systems and shared memory.
+	u64 TaggedFrames[7];
+} FrameStatistics;
 
 /// Implemented in `SyscallWrapper.s`.
 u64 SyscallWrapper(usz syscallNumber, u64 arg1, u64 arg2, u64 arg3, u64 arg4, u64 arg5, u64 arg6);
 
 u64 ScPrint(const i8* text);
+u64 ScFrameStatistics(FrameStatistics* statistics);
+/// Maps the shared memory object with the given name, creating a zeroed one of the given size if there isn't one yet.
+/// A size of 0 only maps an already existing object, the size has to be a multiple of 4 KiB.
+u64 ScSharedMemoryMap(const i8* name, usz sizeBytes, bool writeable, void** mapping);
+u64 ScSharedMemoryUnmap(void* mapping);
+/// Maps the given part of an opened file, both the offset and the size have to be multiples of 4 KiB.
+/// Writes to the mapping are private to the process and never reach the file.
+u64 ScFileMap(usz fileDescriptor, usz offsetBytes, usz countBytes, bool writeable, void** mapping);
+u64 ScFileUnmap(void* mapping, usz countBytes);
+/// Copies the calling process, both of them continue from here.
+/// Returns the copy's process ID in the caller and 0 in the copy, or `PROCESS_FORK_FAILED`.
+u64 ScProcessFork();
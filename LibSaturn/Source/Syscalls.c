@@ -4,3 +4,33 @@ u64 ScPrint(const i8* text)
 {
 	return SyscallWrapper(SYSCALL_PRINT, (u64)text, 0, 0, 0, 0, 0);
 }
+
+u64 ScFrameStatistics(FrameStatistics* statistics)
+{
+	return SyscallWrapper(SYSCALL_FRAME_STATISTICS, (u64)statistics, 0, 0, 0, 0, 0);
+}
+
+u64 ScSharedMemoryMap(const i8* name, usz sizeBytes, bool writeable, void** mapping)
+{
+	return SyscallWrapper(SYSCALL_SHARED_MEMORY_MAP, (u64)name, sizeBytes, writeable, (u64)mapping, 0, 0);
+}
+
+u64 ScSharedMemoryUnmap(void* mapping)
+{
+	return SyscallWrapper(SYSCALL_SHARED_MEMORY_UNMAP, (u64)mapping, 0, 0, 0, 0, 0);
+}
+
+u64 ScFileMap(usz fileDescriptor, usz offsetBytes, usz countBytes, bool writeable, void** mapping)
+{
+	return SyscallWrapper(SYSCALL_FILE_MAP, fileDescriptor, offsetBytes, countBytes, writeable, (u64)mapping, 0);
+}
+
+u64 ScFileUnmap(void* mapping, usz countBytes)
+{
+	return SyscallWrapper(SYSCALL_FILE_UNMAP, (u64)mapping, countBytes, 0, 0, 0, 0);
+}
+
+u64 ScProcessFork()
+{
+	return SyscallWrapper(SYSCALL_PROCESS_FORK, 0, 0, 0, 0, 0, 0);
+}